@@ -0,0 +1,65 @@
+// Measures what publishing a pose costs the tracker: alone, and while reader threads
+// poll the channel as fast as they can. Also reports how many reads were served
+// and how many had to retry because they overlapped a publish.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "pose_channel.h"
+
+static double publish_ns(PoseChannel &channel, const int iterations) {
+    PoseSample sample{openvslam::Mat44_t::Identity(), 0.0, 0, TrackingState::tracking};
+    // warm up the channel's cache lines
+    channel.publish(sample);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        sample.frame_id = i;
+        sample.timestamp = i * 0.033;
+        sample.pose(0, 3) = i;
+        channel.publish(sample);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count() * 1e9 / iterations;
+}
+
+int main(int argc, char **argv) {
+    const int num_readers = argc > 1 ? std::atoi(argv[1]) : 3;
+    const int iterations = 1000000;
+
+    PoseChannel channel;
+    std::cout << "publish, no readers: " << publish_ns(channel, iterations) << " [ns]" << std::endl;
+
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> reads{0};
+    std::atomic<unsigned long> torn{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&] {
+            PoseSample sample;
+            unsigned long count = 0;
+            unsigned long inconsistent = 0;
+            while (!stop) {
+                if (channel.read(sample)) {
+                    // every field was written from the same i, a torn read would mix them
+                    inconsistent += sample.pose(0, 3) != static_cast<double>(sample.frame_id);
+                    ++count;
+                }
+            }
+            reads += count;
+            torn += inconsistent;
+        });
+    }
+
+    const double contended = publish_ns(channel, iterations);
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    std::cout << "publish, " << num_readers << " readers polling: " << contended << " [ns]" << std::endl;
+    std::cout << "reads: " << reads << ", inconsistent reads: " << torn << std::endl;
+    return torn == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Compares the Preprocessor's fused pass (Preprocess.fused_resize) against the
+// separate passes it replaces: cv::resize of the captured frame and the grayscale
+// conversion openvslam does on colour input. The resized colour frame was drawn
+// as it was, so that is all. Reports time per frame and the bytes each variant
+// moves through memory at the configured resolution. Build optimised (the default
+// Release build type) for numbers that mean anything. Scale 1 has nothing to fuse,
+// both variants are then the same cv::cvtColor.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "preprocess.h"
+
+template<typename F>
+static double time_per_frame(const int iterations, F &&f) {
+    // warm up caches and the OpenCV thread pool
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count() / iterations;
+}
+
+static void report(const char *name, const double seconds, const double bytes) {
+    std::cout << name << ": " << seconds * 1e3 << " [ms/frame], " << bytes / 1e6 << " [MB/frame], "
+              << bytes / seconds / 1e9 << " [GB/s]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    const int cols = argc > 1 ? std::atoi(argv[1]) : 1920;
+    const int rows = argc > 2 ? std::atoi(argv[2]) : 960;
+    const float scale = argc > 3 ? static_cast<float>(std::atof(argv[3])) : 0.5f;
+    const int iterations = 200;
+
+    cv::Mat frame(rows, cols, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    const double in_bytes = static_cast<double>(rows) * cols * 3;
+    const double out_pixels = in_bytes / 3 * scale * scale;
+
+    std::cout << "frame " << cols << "x" << rows << ", scale " << scale << std::endl;
+
+    // the previous path: resize, then gray for tracking, each a full pass over memory
+    cv::Mat scaled, gray;
+    const double separate = time_per_frame(iterations, [&] {
+        if (scale != 1.0f) {
+            cv::resize(frame, scaled, cv::Size(), scale, scale, cv::INTER_LINEAR);
+        } else {
+            scaled = frame;
+        }
+        cv::cvtColor(scaled, gray, cv::COLOR_BGR2GRAY);
+    });
+    const double separate_bytes = (scale != 1.0f ? in_bytes + out_pixels * 3 : 0.0)
+                                  + out_pixels * 3 + out_pixels;
+    report("separate passes", separate, separate_bytes);
+
+    Preprocessor preprocess(scale, true);
+    const double fused = time_per_frame(iterations, [&] {
+        preprocess.process(frame);
+    });
+    const double fused_bytes = in_bytes + (scale != 1.0f ? out_pixels * 3 : 0.0) + out_pixels;
+    report("fused pass", fused, fused_bytes);
+
+    std::cout << "speedup: " << separate / fused << "x, memory traffic: "
+              << 100.0 * fused_bytes / separate_bytes << "% of separate passes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Frame time of getting a camera image on screen, before and after the persistent texture:
+// the old path creates a texture, allocates it with glTexImage2D, builds its mipmaps and
+// deletes it again every frame, the new one updates a texture allocated once in place.
+// Runs in a hidden window, without vsync, and waits for the GPU after every frame.
+// The persistent texture is also timed fed through a ring of pixel buffer objects, and from
+// frames in a persistently mapped buffer where the driver supports it.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <opencv2/core/core.hpp>
+
+#include "camera_texture.h"
+
+static void draw_quad() {
+    glBegin(GL_QUADS);
+    glTexCoord2i(0, 0);
+    glVertex2i(-1, 1);
+    glTexCoord2i(0, 1);
+    glVertex2i(-1, -1);
+    glTexCoord2i(1, 1);
+    glVertex2i(1, -1);
+    glTexCoord2i(1, 0);
+    glVertex2i(1, 1);
+    glEnd();
+}
+
+template<typename F>
+static double time_per_frame(GLFWwindow *window, const int iterations, F &&upload) {
+    // warm up the driver's allocations and shader compiles
+    for (int i = 0; i < 10; ++i) {
+        upload(i);
+        draw_quad();
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        upload(i);
+        draw_quad();
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count() / iterations;
+}
+
+int main(int argc, char **argv) {
+    const int cols = argc > 1 ? std::atoi(argv[1]) : 1920;
+    const int rows = argc > 2 ? std::atoi(argv[2]) : 960;
+    const int iterations = 300;
+
+    if (!glfwInit()) {
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(cols, rows, "texture upload bench", NULL, NULL);
+    if (!window) {
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (glewInit() != GLEW_OK) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "renderer: " << glGetString(GL_RENDERER) << ", frame " << cols << "x" << rows
+              << (GLEW_ARB_texture_storage ? ", ARB_texture_storage" : "") << std::endl;
+
+    glViewport(0, 0, cols, rows);
+    glEnable(GL_TEXTURE_2D);
+
+    // a few different frames, so no driver can skip an upload of unchanged data
+    cv::Mat frames[4];
+    for (auto &frame : frames) {
+        frame.create(rows, cols, CV_8UC3);
+        cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+
+    // the previous frame's texture is deleted once it has been drawn, as draw_frame() used to
+    GLuint per_frame_texture = 0;
+    const double before = time_per_frame(window, iterations, [&](const int i) {
+        const cv::Mat &frame = frames[i % 4];
+        glDeleteTextures(1, &per_frame_texture);
+        glGenTextures(1, &per_frame_texture);
+        glBindTexture(GL_TEXTURE_2D, per_frame_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame.cols, frame.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, frame.ptr());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    });
+    glDeleteTextures(1, &per_frame_texture);
+    std::cout << "texture per frame with mipmaps: " << before * 1e3 << " [ms/frame]" << std::endl;
+
+    CameraTexture texture;
+    const double after = time_per_frame(window, iterations, [&](const int i) {
+        texture.upload(frames[i % 4]);
+    });
+    std::cout << "persistent texture, glTexSubImage2D: " << after * 1e3 << " [ms/frame]" << std::endl;
+    std::cout << "speedup: " << before / after << "x" << std::endl;
+    texture.release();
+
+    const unsigned int num_buffers = argc > 3 ? std::atoi(argv[3]) : 3;
+    CameraTexture streamed;
+    streamed.set_upload_buffers(num_buffers);
+    const double buffered = time_per_frame(window, iterations, [&](const int i) {
+        streamed.upload(frames[i % 4]);
+    });
+    std::cout << "persistent texture, " << num_buffers << " pixel buffers: " << buffered * 1e3 << " [ms/frame]"
+              << std::endl;
+    streamed.print_stats();
+    streamed.release();
+
+    // frames in a persistently mapped buffer, filled the way the tracker fills its display frame
+    CameraTexture mapped;
+    auto mapped_frames = mapped.map_frames(num_buffers, rows, cols, CV_8UC3);
+    if (!mapped_frames.empty()) {
+        const double persistent = time_per_frame(window, iterations, [&](const int i) {
+            cv::Mat &frame = mapped_frames[i % mapped_frames.size()];
+            mapped.finish_with(frame);
+            frames[i % 4].copyTo(frame);
+            mapped.upload(frame);
+        });
+        std::cout << "persistently mapped frames: " << persistent * 1e3 << " [ms/frame]" << std::endl;
+        mapped.print_stats();
+    } else {
+        std::cout << "no ARB_buffer_storage, persistently mapped frames not timed" << std::endl;
+    }
+    mapped.release();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
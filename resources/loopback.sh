@@ -0,0 +1,11 @@
+#! /bin/sh
+
+# Streams a synthetic test pattern as RTP/H.264 to the local port read by the
+# gstreamer frame source (Capture.source: "gstreamer"), so it can be exercised
+# without a camera or a remote sender.
+
+gst-launch-1.0 videotestsrc is-live=true pattern=ball \
+    ! video/x-raw,width=1920,height=960,framerate=30/1 \
+    ! x264enc tune=zerolatency speed-preset=ultrafast key-int-max=30 \
+    ! rtph264pay config-interval=1 pt=96 \
+    ! udpsink host=127.0.0.1 port=5000
@@ -7,5 +7,7 @@ out vec2 TexCoord;
 void main()
 {
     gl_Position = vec4(aPos, 1.0);
-    TexCoord = aTexCoord;
+    // flipping both texture coordinates shows the frame as the CPU flip around both axes did
+    // (upright and mirrored, camera frames are uploaded top row first) without touching the pixels
+    TexCoord = vec2(1.0) - aTexCoord;
 }
\ No newline at end of file
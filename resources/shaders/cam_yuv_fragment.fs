@@ -0,0 +1,26 @@
+#version 110
+
+varying vec2 TexCoord;
+
+uniform sampler2D yPlane;
+// I420: U in uPlane and V in vPlane, NV12: U and V interleaved in uPlane's luminance and alpha
+uniform sampler2D uPlane;
+uniform sampler2D vPlane;
+uniform bool interleaved;
+
+void main()
+{
+    // BT.601 limited range, as yuv_to_bgr() converts on the CPU
+    float y = 1.164 * (texture2D(yPlane, TexCoord).r - 16.0 / 255.0);
+    vec2 uv;
+    if (interleaved) {
+        uv = texture2D(uPlane, TexCoord).ra;
+    } else {
+        uv = vec2(texture2D(uPlane, TexCoord).r, texture2D(vPlane, TexCoord).r);
+    }
+    uv -= 128.0 / 255.0;
+    gl_FragColor = vec4(y + 1.596 * uv.y,
+                        y - 0.392 * uv.x - 0.813 * uv.y,
+                        y + 2.017 * uv.x,
+                        1.0);
+}
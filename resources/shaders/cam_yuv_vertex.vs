@@ -0,0 +1,10 @@
+#version 110
+
+varying vec2 TexCoord;
+
+void main()
+{
+    // the camera quad is drawn with the fixed function matrices and texture coordinates
+    gl_Position = ftransform();
+    TexCoord = gl_MultiTexCoord0.st;
+}
@@ -0,0 +1,341 @@
+#ifndef OPEN_GL_TEST_CAMERA_TEXTURE_H
+#define OPEN_GL_TEST_CAMERA_TEXTURE_H
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <opencv2/core/core.hpp>
+
+// The camera image as a texture that lives as long as the video keeps its size.
+//
+// Storage is allocated once per resolution, immutable with glTexStorage2D where
+// ARB_texture_storage is available and with a single glTexImage2D otherwise, and every
+// frame is copied into it with glTexSubImage2D. The image is drawn at about its own size,
+// so there is a single level and no mipmaps to regenerate per frame.
+//
+// With a ring of pixel buffer objects the frame is first copied into the next buffer of the
+// ring and the texture is updated from there, which returns right away and lets the GPU pull
+// the pixels while the CPU fills the following buffer with the next frame. A fence after each
+// upload tells whether a buffer is still in flight when its turn comes again: such stalls mean
+// the ring is too shallow.
+//
+// Where ARB_buffer_storage is available the frames themselves can live in GPU visible memory:
+// map_frames() hands out images backed by one persistently and coherently mapped buffer, and
+// whoever fills them (the tracker copying out its display image) writes straight into it.
+// Uploading such an image needs no copy at all. Its fence is waited for in finish_with() before
+// the image is handed back to be overwritten.
+class CameraTexture {
+private:
+    GLuint texture = 0;
+    int cols = 0;
+    int rows = 0;
+    int type = -1;
+
+    // pixel buffer ring, empty for direct uploads from client memory
+    unsigned int num_buffers = 0;
+    std::vector<GLuint> buffers;
+    std::vector<GLsync> fences;
+    unsigned int next_buffer = 0;
+    size_t buffer_size = 0;
+
+    // persistently mapped frames, one fence per frame
+    GLuint mapped_buffer = 0;
+    unsigned char *mapped = nullptr;
+    size_t mapped_stride = 0;
+    std::vector<GLsync> mapped_fences;
+
+    unsigned long uploads = 0;
+    unsigned long mapped_uploads = 0;
+    unsigned long stalls = 0;
+    double stall_time = 0.0;
+
+    // 2 channels are an interleaved chroma plane, sampled as luminance (U) and alpha (V)
+    static GLenum upload_format(const cv::Mat &image) {
+        switch (image.channels()) {
+            case 1:
+                return GL_LUMINANCE;
+            case 2:
+                return GL_LUMINANCE_ALPHA;
+            default:
+                return GL_BGR;
+        }
+    }
+
+    static GLenum storage_format(const cv::Mat &image) {
+        switch (image.channels()) {
+            case 1:
+                return GL_LUMINANCE8;
+            case 2:
+                return GL_LUMINANCE8_ALPHA8;
+            default:
+                return GL_RGB8;
+        }
+    }
+
+    void allocate(const cv::Mat &image) {
+        release_texture();
+        cols = image.cols;
+        rows = image.rows;
+        type = image.type();
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        const GLenum internal_format = storage_format(image);
+        if (GLEW_ARB_texture_storage) {
+            glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, cols, rows);
+        } else {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, internal_format, cols, rows, 0, upload_format(image), GL_UNSIGNED_BYTE,
+                         nullptr);
+        }
+
+        if (num_buffers >= 2 && GLEW_ARB_pixel_buffer_object) {
+            buffer_size = static_cast<size_t>(cols) * rows * image.elemSize();
+            buffers.resize(num_buffers);
+            fences.assign(num_buffers, nullptr);
+            glGenBuffers(num_buffers, buffers.data());
+            for (const auto buffer : buffers) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            next_buffer = 0;
+        }
+    }
+
+    static void copy_rows(const cv::Mat &image, unsigned char *dst) {
+        const size_t row_size = image.cols * image.elemSize();
+        if (image.isContinuous()) {
+            std::memcpy(dst, image.ptr(), row_size * image.rows);
+            return;
+        }
+        for (int y = 0; y < image.rows; ++y) {
+            std::memcpy(dst + y * row_size, image.ptr(y), row_size);
+        }
+    }
+
+    // Wait until the GPU passed fence, counting it as a stall if it hadn't already
+    void wait_for(GLsync &fence) {
+        if (fence == nullptr) {
+            return;
+        }
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            const auto tp_wait = std::chrono::steady_clock::now();
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            ++stalls;
+            stall_time += std::chrono::duration_cast<std::chrono::duration<double>>(
+                    std::chrono::steady_clock::now() - tp_wait).count();
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // index of the mapped frame image points into, -1 if it is ordinary memory
+    int mapped_index(const cv::Mat &image) const {
+        if (!mapped || image.data < mapped || image.data >= mapped + mapped_stride * mapped_fences.size()) {
+            return -1;
+        }
+        return static_cast<int>((image.data - mapped) / mapped_stride);
+    }
+
+    void upload_mapped(const cv::Mat &image, const int i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mapped_buffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, (image.step[0] % 4) == 0 ? 4 : 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cols, rows, upload_format(image), GL_UNSIGNED_BYTE,
+                        reinterpret_cast<const void *>(image.data - mapped));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (mapped_fences[i]) {
+            glDeleteSync(mapped_fences[i]);
+        }
+        mapped_fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++mapped_uploads;
+    }
+
+    void upload_through_buffer(const cv::Mat &image) {
+        const unsigned int i = next_buffer;
+        next_buffer = (next_buffer + 1) % buffers.size();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+        if (GLEW_ARB_sync) {
+            wait_for(fences[i]);
+        } else {
+            // no fences to tell, orphan the storage so mapping never waits for the GPU
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr, GL_STREAM_DRAW);
+        }
+
+        auto *dst = static_cast<unsigned char *>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+        if (dst) {
+            copy_rows(image, dst);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // rows are packed in the buffer
+            glPixelStorei(GL_UNPACK_ALIGNMENT, ((cols * image.elemSize()) % 4) == 0 ? 4 : 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cols, rows, upload_format(image), GL_UNSIGNED_BYTE, nullptr);
+            if (GLEW_ARB_sync) {
+                fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void upload_direct(const cv::Mat &image) {
+        // rows of a cv::Mat are packed unless it is a view into a larger one
+        glPixelStorei(GL_UNPACK_ALIGNMENT, (image.step[0] % 4) == 0 ? 4 : 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.step[0] / image.elemSize()));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cols, rows, upload_format(image), GL_UNSIGNED_BYTE, image.ptr());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+
+public:
+    CameraTexture() = default;
+
+    ~CameraTexture() {
+        release();
+    }
+
+    CameraTexture(const CameraTexture &) = delete;
+
+    CameraTexture &operator=(const CameraTexture &) = delete;
+
+    // Stream uploads through a ring of num_buffers pixel buffer objects (2 or more),
+    // 0 uploads straight from the image. Takes effect at the next allocation.
+    void set_upload_buffers(const unsigned int num) {
+        num_buffers = num;
+        release_texture();
+    }
+
+    // Copy image into the texture, reallocating only when its size or type changed. Leaves it bound.
+    void upload(const cv::Mat &image) {
+        if (texture == 0 || image.cols != cols || image.rows != rows || image.type() != type) {
+            allocate(image);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, texture);
+        }
+
+        const int mapped_frame = mapped_index(image);
+        if (mapped_frame >= 0) {
+            upload_mapped(image, mapped_frame);
+        } else if (buffers.empty()) {
+            upload_direct(image);
+        } else {
+            upload_through_buffer(image);
+        }
+        ++uploads;
+    }
+
+    // Allocate count frames of rows x cols pixels of type in one persistently mapped buffer and
+    // return images backed by them. Returns nothing if ARB_buffer_storage or ARB_sync is missing,
+    // then frames keep going through the pixel buffer ring.
+    std::vector<cv::Mat> map_frames(const unsigned int count, const int rows, const int cols, const int type) {
+        std::vector<cv::Mat> frames;
+        if (!GLEW_ARB_buffer_storage || !GLEW_ARB_sync || count == 0) {
+            return frames;
+        }
+        unmap_frames();
+
+        const size_t frame_size = static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+        // keep every frame cache line aligned
+        mapped_stride = (frame_size + 255) & ~static_cast<size_t>(255);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &mapped_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mapped_buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, mapped_stride * count, nullptr, flags);
+        mapped = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mapped_stride * count,
+                                                               flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!mapped) {
+            std::cout << "Cannot map the frame buffer persistently, using pixel buffers" << std::endl;
+            unmap_frames();
+            return frames;
+        }
+
+        mapped_fences.assign(count, nullptr);
+        for (unsigned int i = 0; i < count; ++i) {
+            frames.emplace_back(rows, cols, type, mapped + i * mapped_stride);
+        }
+        return frames;
+    }
+
+    // Wait until the GPU is done reading image, before it goes back to be overwritten.
+    // Does nothing for images that aren't mapped frames.
+    void finish_with(const cv::Mat &image) {
+        const int i = mapped_index(image);
+        if (i >= 0) {
+            wait_for(mapped_fences[i]);
+        }
+    }
+
+    // Images returned by map_frames() must not be used after this
+    void unmap_frames() {
+        for (auto &fence : mapped_fences) {
+            if (fence) {
+                glDeleteSync(fence);
+            }
+        }
+        mapped_fences.clear();
+        if (mapped_buffer != 0) {
+            if (mapped) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mapped_buffer);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &mapped_buffer);
+            mapped_buffer = 0;
+        }
+        mapped = nullptr;
+        mapped_stride = 0;
+    }
+
+    void bind() const {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    void release() {
+        release_texture();
+        unmap_frames();
+    }
+
+    // the texture and the pixel buffer ring
+    void release_texture() {
+        for (auto &fence : fences) {
+            if (fence) {
+                glDeleteSync(fence);
+            }
+        }
+        fences.clear();
+        if (!buffers.empty()) {
+            glDeleteBuffers(buffers.size(), buffers.data());
+            buffers.clear();
+        }
+        if (texture != 0) {
+            glDeleteTextures(1, &texture);
+            texture = 0;
+        }
+        cols = rows = 0;
+        type = -1;
+    }
+
+    void print_stats() const {
+        std::cout << "texture uploads: " << uploads;
+        if (mapped) {
+            std::cout << ", " << mapped_uploads << " from persistently mapped frames, " << stalls
+                      << " stalls waiting " << stall_time << "[s]";
+        } else if (!buffers.empty()) {
+            std::cout << " through " << buffers.size() << " pixel buffers, " << stalls << " stalls waiting "
+                      << stall_time << "[s]" << (GLEW_ARB_sync ? "" : " (no ARB_sync, stalls not measured)");
+        }
+        std::cout << std::endl;
+    }
+};
+
+#endif
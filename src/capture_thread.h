@@ -0,0 +1,98 @@
+#ifndef OPEN_GL_TEST_CAPTURE_THREAD_H
+#define OPEN_GL_TEST_CAPTURE_THREAD_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "frame_ring.h"
+#include "frame_source.h"
+#include "thread_policy.h"
+#include "timestamp_stats.h"
+
+// Reads frames from a source on a dedicated thread and pushes them into a ring,
+// so the camera driver is serviced regardless of how long tracking or drawing takes
+class CaptureThread {
+private:
+    FrameSource &source;
+    FrameRing &ring;
+    const std::string name;
+    const ThreadPolicy policy;
+
+    std::thread thread;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<bool> running{false};
+
+    std::atomic<unsigned long> captured_frames{0};
+
+    // intervals as delivered by the source, before any frame is dropped by the ring
+    TimestampStats source_stats;
+
+    void run() {
+        apply_thread_policy(name, policy);
+
+        Frame frame;
+        unsigned long next_id = 0;
+
+        while (!stop_requested) {
+            if (!source.read(frame)) {
+                std::cout << "LOG :: CAPTURE SOURCE ENDED" << std::endl;
+                break;
+            }
+            if (frame.image.empty()) {
+                continue;
+            }
+            frame.id = next_id++;
+            ++captured_frames;
+            source_stats.add(frame.timestamp);
+
+            if (!ring.push(frame)) {
+                break;
+            }
+        }
+
+        // let the consumer drain what is left and then stop
+        running = false;
+        ring.close();
+    }
+
+public:
+    CaptureThread(FrameSource &source, FrameRing &ring, const double nominal_interval, const std::string &name,
+                  const ThreadPolicy &policy)
+            : source(source), ring(ring), name(name), policy(policy), source_stats(nominal_interval) {}
+
+    ~CaptureThread() {
+        stop();
+    }
+
+    void start() {
+        running = true;
+        thread = std::thread(&CaptureThread::run, this);
+    }
+
+    void stop() {
+        stop_requested = true;
+        ring.close();
+        // a source waiting for a frame that never comes would keep the thread from ever seeing the flag
+        source.interrupt();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    bool is_running() const {
+        return running;
+    }
+
+    unsigned long captured() const {
+        return captured_frames;
+    }
+
+    // only safe to read once the thread has been stopped
+    const TimestampStats &stats() const {
+        return source_stats;
+    }
+};
+
+#endif
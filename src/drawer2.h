@@ -57,18 +57,16 @@ private:
 
     }
 
-    unsigned char *cvMat2TexInput(cv::Mat &img) {
-        cvtColor(img, img, cv::COLOR_BGR2RGB);
-        flip(img, img, -1);
-        return img.data;
-    }
-
-    void draw(cv::Mat &frame) {
-        unsigned char *image = cvMat2TexInput(frame);
-        if (image) {
+    // The BGR frame is uploaded as it is: the texture swizzle set up in setup() reorders the
+    // channels and cam_vertex2.vs flips the texture coordinates, so the frame the tracker
+    // used is never converted or modified on the CPU
+    void draw(const cv::Mat &frame) {
+        if (frame.data) {
             int width = frame.cols;
             int height = frame.rows;
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, (frame.step[0] % 4) == 0 ? 4 : 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, frame.data);
         } else {
             std::cout << "Failed to load texture." << std::endl;
         }
@@ -214,6 +212,10 @@ private:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+        // frames are uploaded in OpenCV's BGR order, read them back as RGB
+        const GLint bgr_swizzle[] = {GL_BLUE, GL_GREEN, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, bgr_swizzle);
+
     }
 
 public:
@@ -223,7 +225,7 @@ public:
     }
 
 
-    void update(cv::Mat &frame, openvslam::Mat44_t &pose) {
+    void update(const cv::Mat &frame, openvslam::Mat44_t &pose) {
         std::cout << "Drawer starting to draw" << std::endl;
 
 //        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT); // Clear entire screen:
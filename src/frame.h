@@ -0,0 +1,66 @@
+#ifndef OPEN_GL_TEST_FRAME_H
+#define OPEN_GL_TEST_FRAME_H
+
+#include <memory>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+#include <openvslam/type.h>
+
+// Camera pose without Eigen's alignment requirement. Frames live in std::vector ring slots and
+// poses in other standard containers, whose C++11 allocators don't honour that alignment.
+typedef Eigen::Matrix<double, 4, 4, Eigen::DontAlign> UnalignedMat44_t;
+
+// Memory layout of a frame's pixels
+enum class PixelFormat {
+    // packed 8 bit BGR in image
+    bgr,
+    // 8 bit luma in image, half resolution U and V planes in chroma[0] and chroma[1]
+    i420,
+    // 8 bit luma in image, half resolution interleaved UV plane (CV_8UC2) in chroma[0]
+    nv12
+};
+
+// A captured image plus the bookkeeping that travels with it through the pipeline
+struct Frame {
+    PixelFormat format = PixelFormat::bgr;
+    // BGR pixels, or the luma plane for YUV formats
+    cv::Mat image;
+    // chroma planes for YUV formats
+    cv::Mat chroma[2];
+    // sequence number assigned by the capture thread
+    unsigned long id = 0;
+    // acquisition time in seconds, taken from the source (buffer PTS) or the arrival time
+    double timestamp = 0.0;
+    // set when image points into memory owned by the source (e.g. a mapped GstBuffer),
+    // which stays valid until the last copy of this pointer is released
+    std::shared_ptr<void> owner;
+    // camera pose estimated by the tracker for this frame, identity until it has been tracked
+    UnalignedMat44_t pose = UnalignedMat44_t::Identity();
+    bool has_pose = false;
+
+    // exchange contents without touching pixel data, so buffers can be recycled
+    void swap(Frame &other) {
+        std::swap(format, other.format);
+        cv::swap(image, other.image);
+        cv::swap(chroma[0], other.chroma[0]);
+        cv::swap(chroma[1], other.chroma[1]);
+        std::swap(id, other.id);
+        std::swap(timestamp, other.timestamp);
+        owner.swap(other.owner);
+        pose.swap(other.pose);
+        std::swap(has_pose, other.has_pose);
+    }
+
+    // give borrowed source memory back; owned buffers are kept for reuse
+    void release_borrowed() {
+        if (owner) {
+            image.release();
+            chroma[0].release();
+            chroma[1].release();
+            owner.reset();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef OPEN_GL_TEST_FRAME_GOVERNOR_H
+#define OPEN_GL_TEST_FRAME_GOVERNOR_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+// Keeps the tracker real-time on a loaded host by skipping frames.
+//
+// Watches a smoothed per-frame tracking time against a budget, by default the camera's
+// frame interval. When tracking every stride-th frame no longer fits in stride budgets the
+// stride grows, and it shrinks again once the tracker would fit with one frame less in
+// between, with some headroom so it doesn't oscillate. A change is only made after the
+// smoothed time had a few frames to settle on the previous one.
+class FrameGovernor {
+private:
+    const std::string name;
+    const bool enabled;
+    const double budget;
+    const unsigned int max_stride;
+    // fraction of the smaller budget the tracker has to stay under before the stride shrinks
+    const double headroom;
+    // weight of the newest sample in the smoothed tracking time
+    const double smoothing;
+    const unsigned int settle_frames;
+
+    double smoothed = 0.0;
+    unsigned int stride = 1;
+    unsigned int countdown = 0;
+    unsigned int since_change = 0;
+
+    unsigned int skipped = 0;
+    unsigned int changes = 0;
+
+    void set_stride(const unsigned int new_stride) {
+        std::cout << "LOG :: " << name << " GOVERNOR tracking 1 in " << new_stride << " frames (tracking time "
+                  << smoothed << "[s], budget " << budget * stride << "[s])" << std::endl;
+        stride = new_stride;
+        since_change = 0;
+        ++changes;
+    }
+
+public:
+    FrameGovernor(const std::string &name, const bool enabled, const double budget, const unsigned int max_stride,
+                  const double headroom = 0.8, const double smoothing = 0.1, const unsigned int settle_frames = 15)
+            : name(name), enabled(enabled), budget(budget), max_stride(std::max(1u, max_stride)),
+              headroom(headroom), smoothing(smoothing), settle_frames(settle_frames) {}
+
+    // Whether the next frame should be tracked, call once per frame taken from the ring
+    bool should_track() {
+        if (!enabled || countdown == 0) {
+            countdown = stride - 1;
+            return true;
+        }
+        --countdown;
+        ++skipped;
+        return false;
+    }
+
+    // Report how long tracking the last frame took, in seconds
+    void report(const double track_time) {
+        if (!enabled) {
+            return;
+        }
+        smoothed = smoothed == 0.0 ? track_time : smoothed + smoothing * (track_time - smoothed);
+        if (++since_change < settle_frames) {
+            return;
+        }
+
+        if (smoothed > budget * stride && stride < max_stride) {
+            set_stride(stride + 1);
+        } else if (stride > 1 && smoothed < headroom * budget * (stride - 1)) {
+            set_stride(stride - 1);
+        }
+    }
+
+    unsigned int get_stride() const {
+        return stride;
+    }
+
+    unsigned int get_skipped() const {
+        return skipped;
+    }
+
+    void print() const {
+        if (!enabled) {
+            return;
+        }
+        std::cout << "governor: skipped " << skipped << " frames, " << changes << " stride changes, final stride "
+                  << stride << ", smoothed tracking time " << smoothed << "[s] for a " << budget << "[s] budget"
+                  << std::endl;
+    }
+};
+
+#endif
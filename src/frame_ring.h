@@ -0,0 +1,223 @@
+#ifndef OPEN_GL_TEST_FRAME_RING_H
+#define OPEN_GL_TEST_FRAME_RING_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+// What push() does when every slot of the ring is occupied
+enum class OverflowPolicy {
+    // overwrite the oldest queued frame and count it as dropped
+    drop_oldest,
+    // wait until the consumer frees a slot
+    block,
+    // mailbox: the consumer always gets the newest frame and stale ones are replaced silently
+    latest
+};
+
+inline OverflowPolicy overflow_policy_from_string(const std::string &name) {
+    if (name == "block") {
+        return OverflowPolicy::block;
+    }
+    if (name == "latest" || name == "coalesce") {
+        return OverflowPolicy::latest;
+    }
+    if (name != "drop_oldest") {
+        std::cout << "Unknown overflow policy \"" << name << "\", using drop_oldest" << std::endl;
+    }
+    return OverflowPolicy::drop_oldest;
+}
+
+// Fixed-size ring of preallocated frames between one producer and one consumer.
+// Frames are exchanged with swap(), so the same image buffers keep circulating
+// between the ring and its users and nothing is reallocated once they are warm.
+class FrameRing {
+private:
+    std::vector<Frame> slots;
+    const OverflowPolicy policy;
+
+    // index of the oldest queued frame and number of queued frames
+    unsigned int head = 0;
+    unsigned int count = 0;
+    bool closed = false;
+
+    unsigned long pushed_frames = 0;
+    unsigned long dropped_frames = 0;
+    unsigned long superseded_frames = 0;
+
+    // occupancy right after each push, and time spent waiting on either side
+    unsigned long occupancy_sum = 0;
+    unsigned int max_occupancy = 0;
+    double producer_wait = 0.0;
+    double consumer_wait = 0.0;
+
+    mutable std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    static double seconds_since(const std::chrono::steady_clock::time_point &start) {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start)
+                .count();
+    }
+
+    // hand the next frame to the consumer, with the lock held and count > 0
+    void take(Frame &frame) {
+        if (policy == OverflowPolicy::latest && count > 1) {
+            // skip straight to the newest frame, the stale buffers stay in place for reuse
+            superseded_frames += count - 1;
+            head = (head + count - 1) % slots.size();
+            count = 1;
+        }
+
+        frame.swap(slots[head]);
+        // the consumer is done with what it handed back, don't pin source buffers in the ring
+        slots[head].release_borrowed();
+        head = (head + 1) % slots.size();
+        --count;
+    }
+
+public:
+    FrameRing(const unsigned int capacity, const OverflowPolicy policy, const int rows, const int cols, const int type)
+            : slots(capacity == 0 ? 1 : capacity), policy(policy) {
+        for (auto &slot : slots) {
+            slot.image.create(rows, cols, type);
+        }
+    }
+
+    // Ring over images allocated by the caller, e.g. views into GPU visible memory.
+    // The memory must outlive every frame that ever held one of them.
+    FrameRing(const std::vector<cv::Mat> &images, const OverflowPolicy policy)
+            : slots(images.empty() ? 1 : images.size()), policy(policy) {
+        for (unsigned int i = 0; i < images.size(); ++i) {
+            slots[i].image = images[i];
+        }
+    }
+
+    // Queue frame as the newest entry. On return frame holds a recycled buffer.
+    // Returns false if the ring was closed.
+    bool push(Frame &frame) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (policy == OverflowPolicy::block && !closed && count == slots.size()) {
+            const auto tp_wait = std::chrono::steady_clock::now();
+            not_full.wait(lock, [this] { return closed || count < slots.size(); });
+            producer_wait += seconds_since(tp_wait);
+        }
+        if (closed) {
+            return false;
+        }
+
+        if (count < slots.size()) {
+            frame.swap(slots[(head + count) % slots.size()]);
+            ++count;
+        } else {
+            // the slot after the newest one is the oldest one
+            frame.swap(slots[head]);
+            head = (head + 1) % slots.size();
+            if (policy == OverflowPolicy::latest) {
+                ++superseded_frames;
+            } else {
+                ++dropped_frames;
+            }
+        }
+        ++pushed_frames;
+        occupancy_sum += count;
+        max_occupancy = std::max(max_occupancy, count);
+
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Take the oldest queued frame (the newest one in latest mode), waiting for one if necessary.
+    // The buffer previously held by frame goes back into the ring.
+    // Returns false once the ring is closed and drained.
+    bool pop(Frame &frame) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!closed && count == 0) {
+            const auto tp_wait = std::chrono::steady_clock::now();
+            not_empty.wait(lock, [this] { return closed || count > 0; });
+            consumer_wait += seconds_since(tp_wait);
+        }
+        if (count == 0) {
+            return false;
+        }
+        take(frame);
+
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    // Like pop(), but returns false right away instead of waiting when nothing is queued
+    bool try_pop(Frame &frame) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (count == 0) {
+            return false;
+        }
+        take(frame);
+
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    // Wake up every waiter; queued frames can still be popped
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    unsigned int capacity() const {
+        return slots.size();
+    }
+
+    unsigned int size() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return count;
+    }
+
+    unsigned long pushed() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return pushed_frames;
+    }
+
+    unsigned long dropped() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return dropped_frames;
+    }
+
+    // frames replaced by a newer one in latest mode
+    unsigned long superseded() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return superseded_frames;
+    }
+
+    // mean number of queued frames right after a push
+    double mean_occupancy() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return pushed_frames > 0 ? static_cast<double>(occupancy_sum) / pushed_frames : 0.0;
+    }
+
+    // Occupancy and backpressure of the stage boundary this ring sits on.
+    // A ring that is mostly full is in front of the bottleneck stage, one that is mostly empty behind it.
+    void print(const std::string &name) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::cout << name << " queue: " << pushed_frames << " pushed, " << dropped_frames << " dropped, "
+                  << superseded_frames << " superseded, occupancy mean "
+                  << (pushed_frames > 0 ? static_cast<double>(occupancy_sum) / pushed_frames : 0.0)
+                  << " max " << max_occupancy << " of " << slots.size() << ", producer blocked " << producer_wait
+                  << "[s], consumer waited " << consumer_wait << "[s]" << std::endl;
+    }
+};
+
+#endif
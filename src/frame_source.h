@@ -0,0 +1,83 @@
+#ifndef OPEN_GL_TEST_FRAME_SOURCE_H
+#define OPEN_GL_TEST_FRAME_SOURCE_H
+
+#include <chrono>
+
+#include <opencv2/videoio.hpp>
+
+#include "frame.h"
+
+// seconds on the monotonic clock, used to stamp frames whose source has no timestamp of its own
+inline double monotonic_now() {
+    return std::chrono::duration_cast<std::chrono::duration<double>>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Anything that can produce frames for the capture thread
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    virtual bool is_opened() const = 0;
+
+    // live sources keep producing whether or not we keep up, so dropping frames is acceptable
+    virtual bool is_live() const {
+        return true;
+    }
+
+    virtual int width() const = 0;
+
+    virtual int height() const = 0;
+
+    // OpenCV type of the images delivered by read(), used to preallocate buffers
+    virtual int type() const = 0;
+
+    // pixel layout of the frames delivered by read(), YUV sources keep the chroma planes in the frame
+    virtual PixelFormat format() const {
+        return PixelFormat::bgr;
+    }
+
+    // Fill frame with the next image and its acquisition timestamp, reusing the buffer when possible.
+    // Returns false once the source is exhausted or broken.
+    virtual bool read(Frame &frame) = 0;
+
+    // Make a read() blocked on another thread return false soon, and every later one right away.
+    // Sources whose read() always returns within a frame interval don't need to do anything.
+    virtual void interrupt() {}
+};
+
+// Frame source backed by a cv::VideoCapture device
+class VideoCaptureSource : public FrameSource {
+private:
+    cv::VideoCapture video;
+
+public:
+    explicit VideoCaptureSource(const unsigned int cam_num) : video(cam_num) {}
+
+    bool is_opened() const override {
+        return video.isOpened();
+    }
+
+    int width() const override {
+        return static_cast<int>(video.get(cv::CAP_PROP_FRAME_WIDTH));
+    }
+
+    int height() const override {
+        return static_cast<int>(video.get(cv::CAP_PROP_FRAME_HEIGHT));
+    }
+
+    int type() const override {
+        return CV_8UC3;
+    }
+
+    bool read(Frame &frame) override {
+        if (!video.read(frame.image)) {
+            return false;
+        }
+        // the capture API has no reliable buffer time for live devices, so use the arrival time
+        frame.timestamp = monotonic_now();
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef OPEN_GL_TEST_GST_FRAME_SOURCE_H
+#define OPEN_GL_TEST_GST_FRAME_SOURCE_H
+
+#ifdef USE_GSTREAMER
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+
+#include "frame_source.h"
+
+// Keeps a decoded buffer mapped while a cv::Mat header points into its memory.
+// The buffer goes back to GStreamer when the last frame referencing it lets go.
+struct GstMappedSample {
+    GstSample *sample;
+    GstBuffer *buffer;
+    GstMapInfo map;
+
+    GstMappedSample(GstSample *sample, GstBuffer *buffer, const GstMapInfo &map)
+            : sample(sample), buffer(buffer), map(map) {}
+
+    ~GstMappedSample() {
+        gst_buffer_unmap(buffer, &map);
+        gst_sample_unref(sample);
+    }
+};
+
+// Runs a GStreamer pipeline in-process and pulls decoded frames from an appsink named "sink".
+// Frames are cv::Mat headers over the mapped GstBuffer, so nothing is copied on the way in.
+// The appsink may deliver BGR, or the decoder's own I420/NV12 planes to skip colour conversion.
+class GstFrameSource : public FrameSource {
+private:
+    GstElement *pipeline = nullptr;
+    GstAppSink *sink = nullptr;
+
+    // first sample, pulled up front to learn the negotiated caps
+    GstSample *pending = nullptr;
+    GstCaps *current_caps = nullptr;
+    GstVideoInfo info;
+
+    PixelFormat pixel_format = PixelFormat::bgr;
+
+    std::atomic<bool> interrupted{false};
+
+    // Wait for the next sample in short slices, so interrupt() is noticed even when the stream
+    // stalls without ever sending EOS, e.g. a udpsrc whose sender went away. Null at EOS or when
+    // interrupted.
+    GstSample *pull_sample() {
+        while (!interrupted) {
+            GstSample *sample = gst_app_sink_try_pull_sample(sink, 100 * GST_MSECOND);
+            if (sample || gst_app_sink_is_eos(sink)) {
+                return sample;
+            }
+        }
+        return nullptr;
+    }
+
+    bool update_info(GstSample *sample) {
+        GstCaps *caps = gst_sample_get_caps(sample);
+        if (caps && current_caps && gst_caps_is_equal(caps, current_caps)) {
+            return true;
+        }
+        if (!caps || !gst_video_info_from_caps(&info, caps)) {
+            std::cout << "GStreamer sample without usable video caps" << std::endl;
+            return false;
+        }
+        switch (GST_VIDEO_INFO_FORMAT(&info)) {
+            case GST_VIDEO_FORMAT_BGR:
+                pixel_format = PixelFormat::bgr;
+                break;
+            case GST_VIDEO_FORMAT_I420:
+                pixel_format = PixelFormat::i420;
+                break;
+            case GST_VIDEO_FORMAT_NV12:
+                pixel_format = PixelFormat::nv12;
+                break;
+            default:
+                std::cout << "GStreamer appsink must deliver video/x-raw with format BGR, I420 or NV12" << std::endl;
+                return false;
+        }
+        gst_caps_replace(&current_caps, caps);
+        return true;
+    }
+
+    // cv::Mat header over one plane of the mapped buffer
+    cv::Mat plane(const GstMapInfo &map, const unsigned int index, const int rows, const int cols,
+                  const int type) const {
+        return cv::Mat(rows, cols, type, map.data + GST_VIDEO_INFO_PLANE_OFFSET(&info, index),
+                       GST_VIDEO_INFO_PLANE_STRIDE(&info, index));
+    }
+
+public:
+    explicit GstFrameSource(const std::string &description) {
+        gst_init(nullptr, nullptr);
+        gst_video_info_init(&info);
+
+        GError *error = nullptr;
+        pipeline = gst_parse_launch(description.c_str(), &error);
+        if (error) {
+            std::cout << "GStreamer pipeline error: " << error->message << std::endl;
+            g_error_free(error);
+            if (pipeline) {
+                gst_object_unref(pipeline);
+                pipeline = nullptr;
+            }
+            return;
+        }
+
+        GstElement *element = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+        if (!element) {
+            std::cout << "GStreamer pipeline has no appsink named \"sink\"" << std::endl;
+            return;
+        }
+        sink = GST_APP_SINK(element);
+
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+        pending = gst_app_sink_try_pull_sample(sink, 10 * GST_SECOND);
+        if (pending && !update_info(pending)) {
+            gst_sample_unref(pending);
+            pending = nullptr;
+        }
+    }
+
+    ~GstFrameSource() override {
+        if (pending) {
+            gst_sample_unref(pending);
+        }
+        gst_caps_replace(&current_caps, nullptr);
+        if (pipeline) {
+            gst_element_set_state(pipeline, GST_STATE_NULL);
+        }
+        if (sink) {
+            gst_object_unref(sink);
+        }
+        if (pipeline) {
+            gst_object_unref(pipeline);
+        }
+    }
+
+    GstFrameSource(const GstFrameSource &) = delete;
+
+    GstFrameSource &operator=(const GstFrameSource &) = delete;
+
+    bool is_opened() const override {
+        return current_caps != nullptr;
+    }
+
+    int width() const override {
+        return GST_VIDEO_INFO_WIDTH(&info);
+    }
+
+    int height() const override {
+        return GST_VIDEO_INFO_HEIGHT(&info);
+    }
+
+    int type() const override {
+        return pixel_format == PixelFormat::bgr ? CV_8UC3 : CV_8UC1;
+    }
+
+    PixelFormat format() const override {
+        return pixel_format;
+    }
+
+    void interrupt() override {
+        interrupted = true;
+    }
+
+    bool read(Frame &frame) override {
+        // drop whatever the recycled frame still references before blocking on the next sample
+        frame.image.release();
+        frame.chroma[0].release();
+        frame.chroma[1].release();
+        frame.owner.reset();
+
+        if (!sink) {
+            return false;
+        }
+        GstSample *sample = pending ? pending : pull_sample();
+        pending = nullptr;
+        if (!sample) {
+            // end of stream or interrupted
+            return false;
+        }
+
+        GstBuffer *buffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (!buffer || !update_info(sample) || !gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            gst_sample_unref(sample);
+            return false;
+        }
+        auto mapped = std::make_shared<GstMappedSample>(sample, buffer, map);
+
+        const int rows = GST_VIDEO_INFO_HEIGHT(&info);
+        const int cols = GST_VIDEO_INFO_WIDTH(&info);
+        frame.format = pixel_format;
+        switch (pixel_format) {
+            case PixelFormat::bgr:
+                frame.image = plane(mapped->map, 0, rows, cols, CV_8UC3);
+                break;
+            case PixelFormat::i420:
+                frame.image = plane(mapped->map, 0, rows, cols, CV_8UC1);
+                frame.chroma[0] = plane(mapped->map, 1, (rows + 1) / 2, (cols + 1) / 2, CV_8UC1);
+                frame.chroma[1] = plane(mapped->map, 2, (rows + 1) / 2, (cols + 1) / 2, CV_8UC1);
+                break;
+            case PixelFormat::nv12:
+                frame.image = plane(mapped->map, 0, rows, cols, CV_8UC1);
+                frame.chroma[0] = plane(mapped->map, 1, (rows + 1) / 2, (cols + 1) / 2, CV_8UC2);
+                break;
+        }
+        frame.owner = mapped;
+
+        // live pipelines stamp buffers with their capture running time, fall back to arrival time otherwise.
+        // Adding the base time gives the pipeline clock, by default the system monotonic clock, so
+        // timestamps share a clock with monotonic_now() and the renderer.
+        frame.timestamp = GST_BUFFER_PTS_IS_VALID(buffer)
+                          ? static_cast<double>(gst_element_get_base_time(pipeline) + GST_BUFFER_PTS(buffer))
+                            / GST_SECOND
+                          : monotonic_now();
+        return true;
+    }
+};
+
+#endif
+
+#endif
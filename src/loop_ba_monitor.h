@@ -0,0 +1,157 @@
+#ifndef OPEN_GL_TEST_LOOP_BA_MONITOR_H
+#define OPEN_GL_TEST_LOOP_BA_MONITOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <openvslam/system.h>
+
+// Turns openvslam's loop bundle adjustment state into events.
+//
+// openvslam only exposes loop_BA_is_running(), so one thread per SLAM system watches it and
+// notifies everyone else: callbacks fire when a BA starts and ends, is_running() is a plain
+// atomic load for the hot paths, and wait_until_idle() blocks on a condition variable
+// instead of each waiter sleeping and polling on its own.
+class LoopBAMonitor {
+public:
+    typedef std::function<void()> StartCallback;
+    // receives the duration of the finished BA in seconds
+    typedef std::function<void(double)> EndCallback;
+    // receives the seconds the current BA has been running for
+    typedef std::function<void(double)> ProgressCallback;
+
+private:
+    openvslam::system &SLAM;
+    const std::chrono::microseconds poll_interval;
+
+    StartCallback on_start;
+    EndCallback on_end;
+
+    std::thread thread;
+    std::atomic<bool> stop_requested{false};
+
+    mutable std::mutex mutex;
+    std::condition_variable state_changed;
+    std::atomic<bool> running{false};
+    std::chrono::steady_clock::time_point started_at;
+    unsigned int completed = 0;
+
+    static double seconds_between(const std::chrono::steady_clock::time_point &from,
+                                  const std::chrono::steady_clock::time_point &to) {
+        return std::chrono::duration_cast<std::chrono::duration<double>>(to - from).count();
+    }
+
+    void watch() {
+        while (!stop_requested) {
+            const bool now_running = SLAM.loop_BA_is_running();
+            if (now_running != running) {
+                const auto now = std::chrono::steady_clock::now();
+                double duration = 0.0;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    running = now_running;
+                    if (now_running) {
+                        started_at = now;
+                    } else {
+                        duration = seconds_between(started_at, now);
+                        ++completed;
+                    }
+                }
+                state_changed.notify_all();
+
+                if (now_running && on_start) {
+                    on_start();
+                } else if (!now_running && on_end) {
+                    on_end(duration);
+                }
+            }
+            std::this_thread::sleep_for(poll_interval);
+        }
+    }
+
+public:
+    explicit LoopBAMonitor(openvslam::system &SLAM, const double poll_interval = 0.005)
+            : SLAM(SLAM), poll_interval(static_cast<long>(poll_interval * 1e6)) {}
+
+    ~LoopBAMonitor() {
+        stop();
+    }
+
+    LoopBAMonitor(const LoopBAMonitor &) = delete;
+
+    LoopBAMonitor &operator=(const LoopBAMonitor &) = delete;
+
+    // Callbacks run on the monitor thread, set them before start()
+    void set_callbacks(const StartCallback &start_callback, const EndCallback &end_callback) {
+        on_start = start_callback;
+        on_end = end_callback;
+    }
+
+    void start() {
+        stop_requested = false;
+        thread = std::thread(&LoopBAMonitor::watch, this);
+    }
+
+    void stop() {
+        stop_requested = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    bool is_running() const {
+        return running;
+    }
+
+    // seconds the current BA has been running for, 0 when idle
+    double elapsed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return running ? seconds_between(started_at, std::chrono::steady_clock::now()) : 0.0;
+    }
+
+    unsigned int completed_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed;
+    }
+
+    // Block until no BA is running or timeout seconds passed (0 waits forever).
+    // progress, when set, is called every progress_interval seconds while waiting.
+    // Returns false on timeout.
+    bool wait_until_idle(const double timeout, const ProgressCallback &progress = nullptr,
+                         const double progress_interval = 1.0) {
+        const auto tp_start = std::chrono::steady_clock::now();
+        const auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(progress_interval));
+
+        // asks openvslam too, so a BA that started since the last poll isn't missed
+        const auto busy = [this] { return running || SLAM.loop_BA_is_running(); };
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (busy()) {
+            auto wake = std::chrono::steady_clock::now() + step;
+            if (timeout > 0.0) {
+                const auto deadline = tp_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(timeout));
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    return false;
+                }
+                wake = std::min(wake, deadline);
+            }
+            if (!state_changed.wait_until(lock, wake, [&busy] { return !busy(); }) && progress) {
+                const double elapsed_ba = running ? seconds_between(started_at, std::chrono::steady_clock::now())
+                                                  : 0.0;
+                lock.unlock();
+                progress(elapsed_ba);
+                lock.lock();
+            }
+        }
+        return true;
+    }
+};
+
+#endif
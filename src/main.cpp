@@ -12,7 +12,11 @@
 #include <openvslam/config.h>
 #include <numeric>
 
+#include "orb_autotune.h"
 #include "render_video_opengl2.h"
+#include "pose_predictor.h"
+#include "thread_policy.h"
+#include "tracking_pipeline.h"
 
 
 void camera_tracking(const std::shared_ptr<openvslam::config> &cfg,
@@ -21,13 +25,31 @@ void camera_tracking(const std::shared_ptr<openvslam::config> &cfg,
     // load the mask image
     const cv::Mat mask = mask_img_path.empty() ? cv::Mat{} : cv::imread(mask_img_path, cv::IMREAD_GRAYSCALE);
 
-    // build a SLAM system
-    openvslam::system SLAM(cfg, vocab_file_path);
-    // startup the SLAM process
-    SLAM.startup();
-
-    std::cout << "LOG :: SLAM INITIALIZED" << std::endl;
+    // the camera from cfg is drawn in the window, the ones listed in MultiCamera.configs are tracked headless
+    std::vector<std::shared_ptr<openvslam::config>> cfgs{cfg};
+    const auto extra_configs = cfg->yaml_node_["MultiCamera.configs"];
+    if (extra_configs) {
+        for (const auto &config_file : extra_configs) {
+            cfgs.push_back(std::make_shared<openvslam::config>(config_file.as<std::string>()));
+        }
+    }
 
+    // every camera gets a device of its own: Capture.device for the first, then the ones listed
+    // in MultiCamera.devices or the devices following it, whatever the cameras' own configs say
+    const auto first_device = cfg->yaml_node_["Capture.device"].as<unsigned int>(cam_num);
+    const auto devices = cfg->yaml_node_["MultiCamera.devices"].as<std::vector<unsigned int>>(
+            std::vector<unsigned int>());
+
+    // each pipeline loads its SLAM system and opens its camera on threads of its own,
+    // meanwhile the window comes up here and shows the camera until tracking starts.
+    // openvslam::system only takes a vocabulary path, so every system parses and keeps its own copy.
+    std::vector<std::unique_ptr<TrackingPipeline>> pipelines;
+    for (unsigned int i = 0; i < cfgs.size(); ++i) {
+        const auto device = i == 0 ? first_device : i <= devices.size() ? devices[i - 1] : first_device + i;
+        pipelines.emplace_back(new TrackingPipeline("cam" + std::to_string(i), cfgs[i], vocab_file_path, device,
+                                                    mask, scale, map_db_path, i == 0));
+        pipelines.back()->startup_async();
+    }
 
     // create a viewer object
     // and pass the frame_publisher and the map_publisher
@@ -35,102 +57,164 @@ void camera_tracking(const std::shared_ptr<openvslam::config> &cfg,
 //    pangolin_viewer::viewer viewer(cfg, &SLAM, SLAM.get_frame_publisher(), SLAM.get_map_publisher());
 
 
-
-
-    auto video = cv::VideoCapture(cam_num);
-//    auto video = cv::VideoCapture(
-//            "udpsrc port=5000 caps=\"application/x-rtp\" ! rtph264depay ! avdec_h264 ! appsink",
-//            cv::CAP_FFMPEG
-//    );
-
-    window_width = video.get(cv::CAP_PROP_FRAME_WIDTH);
-    window_height = video.get(cv::CAP_PROP_FRAME_HEIGHT);
-    std::cout << "Video width: " << window_width << std::endl;
-    std::cout << "Video height: " << window_height << std::endl;
-
 //    Drawer3 drawer(window_width, window_height);
+    const auto tp_gl = std::chrono::steady_clock::now();
     setup();
+    set_texture_upload_buffers(cfg->yaml_node_["Render.upload_buffers"].as<unsigned int>(3));
 
-    std::cout << "LOG :: DRAWER INITIALIZED" << std::endl;
+    std::cout << "LOG :: DRAWER INITIALIZED in " << seconds_since(tp_gl) << "[s]" << std::endl;
 
+    auto &primary = *pipelines.front();
+    const bool primary_opened = primary.wait_for_source();
+    for (unsigned int i = 1; i < pipelines.size(); ++i) {
+        pipelines[i]->wait_for_source();
+    }
 
-    if (!video.isOpened()) {
+    if (!primary_opened) {
 //        spdlog::critical("cannot open a camera {}", cam_num);
-        SLAM.shutdown();
+        for (auto &pipeline : pipelines) {
+            pipeline->shutdown(false);
+        }
         std::cout << "VIDEO NOT OPENED" << std::endl;
         return;
     }
 
-    cv::Mat frame;
-    double timestamp = 0.0;
-    std::vector<double> track_times;
+    resize_window(primary.width(), primary.height());
 
-    unsigned int num_frame = 0;
-
-    bool is_not_end = true;
-    // run the SLAM in another thread
-//    std::thread thread([&]() {
-    while (is_not_end) {
-        // check if the termination of SLAM system is requested or not
-        if (SLAM.terminate_is_requested()) {
-            break;
+    for (unsigned int i = 1; i < pipelines.size(); ++i) {
+        if (pipelines[i]->is_opened()) {
+            pipelines[i]->run_async();
         }
+    }
+
+    // Three stages run concurrently, each on its own thread: capture fills frame N+1 while the
+    // tracker works on frame N and this thread, which owns the GL context, draws frame N-1.
+    // Bounded rings sit between the stages, each with its own overflow policy.
+    const auto &yaml_node = cfg->yaml_node_;
+    const auto display_ring_size = std::max(1u, yaml_node["Render.ring_size"].as<unsigned int>(2));
+    const auto display_policy = overflow_policy_from_string(
+            yaml_node["Render.overflow_policy"].as<std::string>("latest"));
+
+    // YUV frames are drawn from their planes, converted to colour by the GPU: 1.5 bytes a pixel
+    // to copy and upload instead of 3, and no colour conversion on the tracking thread
+    const bool display_yuv = primary.source_format() != PixelFormat::bgr
+                             && yaml_node["Render.yuv_upload"].as<bool>(true);
+    primary.set_display_yuv(display_yuv);
+
+    // Where the driver can map a buffer persistently the display frames live in it: the ring's
+    // slots, the one the tracker fills and the one being drawn. The tracker's copy then lands
+    // straight in GPU visible memory and the upload copies nothing.
+    std::vector<cv::Mat> display_frames;
+    if (!display_yuv) {
+        display_frames = map_display_frames(display_ring_size + 2, primary.height(), primary.width(), CV_8UC3);
+    }
+    std::unique_ptr<FrameRing> display_ring;
+    Frame tracked;
+    Frame shown;
+    if (display_frames.empty()) {
+        display_ring.reset(new FrameRing(display_ring_size, display_policy, primary.height(), primary.width(),
+                                         display_yuv ? CV_8UC1 : CV_8UC3));
+    } else {
+        tracked.image = display_frames[display_ring_size];
+        shown.image = display_frames[display_ring_size + 1];
+        display_frames.resize(display_ring_size);
+        display_ring.reset(new FrameRing(display_frames, display_policy));
+    }
 
-        is_not_end = video.read(frame);
-        is_not_end = is_not_end && !shouldWindowClose();
+    primary.run_async([&](const Frame &frame, const cv::Mat &image) {
+        // the tracker's images go back to the capture ring, so the renderer gets its own copy
+        if (image.empty()) {
+            tracked.format = frame.format;
+            frame.image.copyTo(tracked.image);
+            frame.chroma[0].copyTo(tracked.chroma[0]);
+            frame.chroma[1].copyTo(tracked.chroma[1]);
+        } else {
+            tracked.format = PixelFormat::bgr;
+            image.copyTo(tracked.image);
+        }
+        tracked.id = frame.id;
+        tracked.timestamp = frame.timestamp;
+        tracked.pose = frame.pose;
+        tracked.has_pose = frame.has_pose;
+        display_ring->push(tracked);
+    });
+
+    // poses are extrapolated to when the frame being drawn will be on screen
+    set_camera_intrinsics(yaml_node["Camera.fx"].as<double>(), yaml_node["Camera.fy"].as<double>(),
+                          yaml_node["Camera.cx"].as<double>(), yaml_node["Camera.cy"].as<double>(),
+                          yaml_node["Camera.cols"].as<int>(), yaml_node["Camera.rows"].as<int>());
+    // poses are only extrapolated to now when frame timestamps are on the clock of now
+    const bool predict_pose = yaml_node["Render.predict_pose"].as<bool>(true) && primary.source_is_live();
+    PosePredictor predictor(yaml_node["Render.pose_history"].as<unsigned int>(4),
+                            yaml_node["Render.max_extrapolation"].as<double>(0.1));
+    double display_latency = yaml_node["Render.display_latency"].as<double>(0.0);
+    if (display_latency <= 0.0) {
+        // with vsync what is drawn now shows up at the next refresh
+        display_latency = display_refresh_interval();
+    }
 
-        if (frame.empty()) {
+    // pinned last, threads started from here before inherit nothing from it
+    apply_thread_policy(primary.get_name(), thread_policy_from_yaml(yaml_node, "render"));
+
+    bool have_frame = false;
+    uint64_t pose_version = 0;
+    PoseSample latest;
+    while (!shouldWindowClose() && primary.is_running()) {
+        // the frame drawn last may go back to the tracker now, once the GPU has read it
+        finish_with_frame(shown.image);
+        const bool new_frame = display_ring->try_pop(shown);
+        have_frame = have_frame || new_frame;
+        // the predictor is fed straight from the tracker, before the frame's image is copied out
+        const auto &pose_channel = primary.pose_channel();
+        if (pose_channel.version() != pose_version) {
+            pose_version = pose_channel.version();
+            if (pose_channel.read(latest)) {
+                if (latest.state == TrackingState::tracking) {
+                    predictor.add(latest.timestamp, latest.pose);
+                } else if (latest.state == TrackingState::lost || latest.state == TrackingState::initializing) {
+                    // nothing to extrapolate from until tracking is back, and no velocity across the gap
+                    predictor.reset();
+                }
+            }
+        }
+        // while loop BA runs, only draw new camera frames and leave the cores to the optimizer
+        if (!have_frame || (!new_frame && primary.loop_BA_is_running())) {
+            // nothing to draw until the first frame arrives
+            glfwWaitEventsTimeout(0.005);
             continue;
         }
-        if (scale != 1.0) {
-            cv::resize(frame, frame, cv::Size(), scale, scale, cv::INTER_LINEAR);
+        if (predict_pose && !predictor.empty()) {
+            update(shown, predictor.predict(monotonic_now() + display_latency), true, new_frame);
+        } else {
+            update(shown, shown.pose, shown.has_pose, new_frame);
         }
-
-        const auto tp_1 = std::chrono::steady_clock::now();
-
-        // input the current currentFrame and estimate the camera pose
-        auto pose = SLAM.feed_monocular_frame(frame, timestamp, mask);
-
-//            std::cout << "pose: " << pose << std::endl;
-
-        update(frame, pose);
-
-        const auto tp_2 = std::chrono::steady_clock::now();
-
-        const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
-        track_times.push_back(track_time);
-
-        timestamp += 1.0 / cfg->camera_->fps_;
-        ++num_frame;
     }
-
-    // wait until the loop BA is finished
-    while (SLAM.loop_BA_is_running()) {
-        std::this_thread::sleep_for(std::chrono::microseconds(5000));
+    primary.request_stop();
+    // the renderer has stopped popping, a tracker blocked on a full display ring would never return
+    display_ring->close();
+    primary.join();
+
+    for (unsigned int i = 1; i < pipelines.size(); ++i) {
+        pipelines[i]->request_stop();
+        pipelines[i]->join();
     }
-//    });
-
-    // run the viewer in the current thread
-
-//    viewer.run();
-
-
-//    thread.join();
 
-    // shutdown the SLAM process
-    SLAM.shutdown();
-
-    terminate();
+    const auto loop_BA_timeout = yaml_node["LoopBA.shutdown_timeout"].as<double>(0.0);
+    for (auto &pipeline : pipelines) {
+        pipeline->shutdown(true, loop_BA_timeout);
+    }
 
-    if (!map_db_path.empty()) {
-        // output the map database
-        SLAM.save_map_database(map_db_path);
+    for (auto &pipeline : pipelines) {
+        pipeline->print_stats();
     }
+    display_ring->print("track -> render");
+    print_render_stats();
 
-    std::sort(track_times.begin(), track_times.end());
-    const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
-    std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
-    std::cout << "mean tracking time: " << total_track_time / track_times.size() << "[s]" << std::endl;
+    // terminate() exits without running destructors, so nothing would flush the files otherwise
+    for (auto &pipeline : pipelines) {
+        pipeline->close();
+    }
+    terminate();
 }
 
 
@@ -152,7 +236,19 @@ int main() {
     auto mask_img_path = "";
     auto map_db_path = folder + "map.msg";
 
-    camera_tracking(cfg, vocab_file_path, 0, mask_img_path, 1, map_db_path);
+    const float scale = 1;
+
+    // time the ORB extractor on this host and track with the settings that fit the budget
+    if (cfg->yaml_node_["AutoTune.enabled"].as<bool>(false)) {
+        // the tracker's own source records, this one would only leave a short recording for it to overwrite
+        const auto tuned_config_file = autotune_orb(cfg, scale, make_frame_source(
+                cfg->yaml_node_, cfg->yaml_node_["Capture.device"].as<unsigned int>(0), "", false));
+        if (!tuned_config_file.empty()) {
+            cfg = std::make_shared<openvslam::config>(tuned_config_file);
+        }
+    }
+
+    camera_tracking(cfg, vocab_file_path, 0, mask_img_path, scale, map_db_path);
 
 //    Drawer drawer;
 //    while (!drawer.shouldWindowClose()) {
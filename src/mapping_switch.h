@@ -0,0 +1,84 @@
+#ifndef OPEN_GL_TEST_MAPPING_SWITCH_H
+#define OPEN_GL_TEST_MAPPING_SWITCH_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <openvslam/system.h>
+
+// Pauses and resumes openvslam's mapping module off the calling thread.
+//
+// disable_mapping_module() waits until the mapper has finished the keyframe it is working on,
+// which can take longer than several frames. request() only records the wanted state and returns,
+// one thread per SLAM system then brings the mapping module there. Requests that arrive while a
+// switch is in progress are coalesced, only the latest one is applied.
+class MappingSwitch {
+private:
+    openvslam::system &SLAM;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable requested;
+    bool stop_requested = false;
+    bool want_paused = false;
+    bool paused = false;
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            requested.wait(lock, [this] { return stop_requested || want_paused != paused; });
+            if (stop_requested) {
+                return;
+            }
+            const bool pause = want_paused;
+            lock.unlock();
+            if (pause) {
+                SLAM.disable_mapping_module();
+            } else {
+                SLAM.enable_mapping_module();
+            }
+            lock.lock();
+            paused = pause;
+        }
+    }
+
+public:
+    explicit MappingSwitch(openvslam::system &SLAM) : SLAM(SLAM) {}
+
+    ~MappingSwitch() {
+        stop();
+    }
+
+    MappingSwitch(const MappingSwitch &) = delete;
+
+    MappingSwitch &operator=(const MappingSwitch &) = delete;
+
+    void start() {
+        stop_requested = false;
+        thread = std::thread(&MappingSwitch::work, this);
+    }
+
+    // Waits for a switch in progress, requests that haven't started yet are dropped
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop_requested = true;
+        }
+        requested.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    // Ask for the mapping module to be paused or running, without waiting for it
+    void request(const bool pause) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            want_paused = pause;
+        }
+        requested.notify_one();
+    }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef OPEN_GL_TEST_MAPPING_THROTTLE_H
+#define OPEN_GL_TEST_MAPPING_THROTTLE_H
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+// Host-wide CPU utilisation from /proc/stat, so load from other processes counts too
+class CpuLoad {
+private:
+    unsigned long long last_busy = 0;
+    unsigned long long last_total = 0;
+
+    static bool read(unsigned long long &busy, unsigned long long &total) {
+        std::ifstream stat("/proc/stat");
+        std::string cpu;
+        unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+        if (!(stat >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal) || cpu != "cpu") {
+            return false;
+        }
+        busy = user + nice + system + irq + softirq + steal;
+        total = busy + idle + iowait;
+        return true;
+    }
+
+public:
+    CpuLoad() {
+        read(last_busy, last_total);
+    }
+
+    // fraction of all cores busy since the previous call (or construction), -1 if unknown
+    double sample() {
+        unsigned long long busy, total;
+        if (!read(busy, total) || total <= last_total) {
+            return -1.0;
+        }
+        const double load = static_cast<double>(busy - last_busy) / (total - last_total);
+        last_busy = busy;
+        last_total = total;
+        return load;
+    }
+};
+
+// Decides when to pause openvslam's mapping module under load and when to resume it.
+//
+// Every interval it looks at the smoothed tracking time and the host CPU load. Mapping is
+// paused once either goes over its pause threshold, and resumed only after both stayed under
+// the lower resume thresholds for a while, so a load spike doesn't flip it back and forth.
+// Tracking keeps localizing against the existing map while mapping is paused.
+class MappingThrottle {
+public:
+    enum class Decision {
+        keep,
+        pause,
+        resume
+    };
+
+private:
+    const std::string name;
+    const bool enabled;
+    const double pause_track_time;
+    const double resume_track_time;
+    const double pause_cpu_load;
+    const double resume_cpu_load;
+    // seconds after the first tracked frame before anything is paused, so the map can initialize
+    const double warmup;
+    // seconds between evaluations, also the CPU load sampling window
+    const double interval;
+    // seconds the load has to stay low before mapping resumes
+    const double resume_after;
+
+    CpuLoad cpu;
+    double smoothed_track_time = 0.0;
+    double first_time = -1.0;
+    double last_evaluation = -1.0;
+    double calm_since = -1.0;
+    bool paused = false;
+
+    unsigned int pauses = 0;
+    double paused_since = 0.0;
+    double paused_total = 0.0;
+
+public:
+    MappingThrottle(const std::string &name, const YAML::Node &yaml_node, const double frame_interval)
+            : name(name), enabled(yaml_node["Mapping.throttle"].as<bool>(false)),
+              pause_track_time(yaml_node["Mapping.pause_track_time"].as<double>(frame_interval)),
+              resume_track_time(yaml_node["Mapping.resume_track_time"].as<double>(0.7 * frame_interval)),
+              pause_cpu_load(yaml_node["Mapping.pause_cpu_load"].as<double>(0.9)),
+              resume_cpu_load(yaml_node["Mapping.resume_cpu_load"].as<double>(0.7)),
+              warmup(yaml_node["Mapping.throttle_warmup"].as<double>(10.0)),
+              interval(yaml_node["Mapping.throttle_interval"].as<double>(0.5)),
+              resume_after(yaml_node["Mapping.resume_after"].as<double>(2.0)) {}
+
+    // Report the tracking time of a frame tracked at time now (seconds, any monotonic clock)
+    Decision update(const double track_time, const double now) {
+        if (!enabled) {
+            return Decision::keep;
+        }
+        smoothed_track_time = smoothed_track_time == 0.0 ? track_time
+                                                         : smoothed_track_time + 0.1 * (track_time - smoothed_track_time);
+        if (first_time < 0.0) {
+            first_time = now;
+        }
+        if (now - first_time < warmup || (last_evaluation >= 0.0 && now - last_evaluation < interval)) {
+            return Decision::keep;
+        }
+        last_evaluation = now;
+        const double load = cpu.sample();
+
+        if (!paused) {
+            const bool slow = smoothed_track_time > pause_track_time;
+            const bool busy = load > pause_cpu_load;
+            if (!slow && !busy) {
+                return Decision::keep;
+            }
+            std::cout << "LOG :: " << name << " MAPPING PAUSED, tracking time " << smoothed_track_time
+                      << "[s] (limit " << pause_track_time << "), CPU load " << load << " (limit " << pause_cpu_load
+                      << ")" << std::endl;
+            paused = true;
+            calm_since = -1.0;
+            ++pauses;
+            paused_since = now;
+            return Decision::pause;
+        }
+
+        if (smoothed_track_time >= resume_track_time || load >= resume_cpu_load) {
+            calm_since = -1.0;
+            return Decision::keep;
+        }
+        if (calm_since < 0.0) {
+            calm_since = now;
+        }
+        if (now - calm_since < resume_after) {
+            return Decision::keep;
+        }
+        std::cout << "LOG :: " << name << " MAPPING RESUMED after " << now - paused_since << "[s], tracking time "
+                  << smoothed_track_time << "[s], CPU load " << load << std::endl;
+        paused = false;
+        paused_total += now - paused_since;
+        return Decision::resume;
+    }
+
+    bool is_enabled() const {
+        return enabled;
+    }
+
+    bool is_paused() const {
+        return paused;
+    }
+
+    void print() const {
+        if (!enabled) {
+            return;
+        }
+        std::cout << "mapping paused " << pauses << " times for " << paused_total << "[s] in total"
+                  << (paused ? ", still paused at exit" : "") << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef OPEN_GL_TEST_ORB_AUTOTUNE_H
+#define OPEN_GL_TEST_ORB_AUTOTUNE_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <openvslam/config.h>
+#include <openvslam/feature/orb_extractor.h>
+#include <yaml-cpp/yaml.h>
+
+#include "frame_source.h"
+#include "preprocess.h"
+
+// ORB extractor settings, as openvslam reads them from the Feature.* keys
+struct OrbSettings {
+    unsigned int max_num_keypoints;
+    float scale_factor;
+    unsigned int num_levels;
+    unsigned int ini_fast_threshold;
+    unsigned int min_fast_threshold;
+};
+
+// Picks the ORB extractor settings that fit a per-frame time budget on this host.
+//
+// Feature extraction is the part of tracking that grows with the image size, the number of
+// pyramid levels and the number of keypoints, and matching and pose optimization grow with the
+// keypoints too. Every candidate is timed extracting the sample frames, and the one with the
+// most keypoints (then the deepest pyramid) whose mean time stays within the budget wins.
+class OrbAutoTuner {
+private:
+    const std::vector<cv::Mat> &frames;
+    const OrbSettings base;
+
+    double time_per_frame(const OrbSettings &settings) const {
+        openvslam::feature::orb_extractor extractor(settings.max_num_keypoints, settings.scale_factor,
+                                                    settings.num_levels, settings.ini_fast_threshold,
+                                                    settings.min_fast_threshold);
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+        // warm up the extractor's pyramid buffers
+        extractor.extract(frames.front(), cv::Mat(), keypoints, descriptors);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &frame : frames) {
+            extractor.extract(frame, cv::Mat(), keypoints, descriptors);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count() / frames.size();
+    }
+
+public:
+    // frames are grayscale images as fed to the tracker
+    OrbAutoTuner(const std::vector<cv::Mat> &frames, const OrbSettings &base) : frames(frames), base(base) {}
+
+    // Best settings within budget seconds of extraction per frame, or the cheapest candidate if none fits
+    OrbSettings tune(const double budget, const std::vector<unsigned int> &keypoint_counts,
+                     const std::vector<unsigned int> &level_counts) const {
+        OrbSettings best = base;
+        bool found = false;
+        double cheapest_time = 0.0;
+
+        for (const auto num_keypoints : keypoint_counts) {
+            for (const auto num_levels : level_counts) {
+                OrbSettings candidate = base;
+                candidate.max_num_keypoints = num_keypoints;
+                candidate.num_levels = num_levels;
+                const double time = time_per_frame(candidate);
+                const bool fits = time <= budget;
+                std::cout << "LOG :: ORB " << num_keypoints << " keypoints, " << num_levels << " levels: "
+                          << time << "[s]" << (fits ? "" : " over budget") << std::endl;
+
+                if (fits) {
+                    const bool better = !found || num_keypoints > best.max_num_keypoints
+                                        || (num_keypoints == best.max_num_keypoints && num_levels > best.num_levels);
+                    if (better) {
+                        best = candidate;
+                    }
+                    found = true;
+                } else if (!found && (cheapest_time == 0.0 || time < cheapest_time)) {
+                    best = candidate;
+                    cheapest_time = time;
+                }
+            }
+        }
+        if (!found) {
+            std::cout << "LOG :: NO ORB SETTINGS FIT " << budget << "[s], using the cheapest" << std::endl;
+        }
+        return best;
+    }
+};
+
+// Time the ORB extractor on frames of the configured source and write a copy of the config
+// with the richest Feature.* settings that fit AutoTune.budget to AutoTune.output.
+// Returns the written config's path, or an empty string if nothing could be tuned.
+inline std::string autotune_orb(const std::shared_ptr<openvslam::config> &cfg, const float scale,
+                                std::unique_ptr<FrameSource> video) {
+    const auto &yaml_node = cfg->yaml_node_;
+    const auto num_frames = yaml_node["AutoTune.frames"].as<unsigned int>(30);
+    auto budget = yaml_node["AutoTune.budget"].as<double>(0.0);
+    if (budget <= 0.0) {
+        budget = 0.5 / cfg->camera_->fps_;
+    }
+    const auto output_path = yaml_node["AutoTune.output"].as<std::string>("./resources/config.tuned.yaml");
+
+    if (!video->is_opened()) {
+        std::cout << "LOG :: AUTOTUNE cannot open the video source" << std::endl;
+        return "";
+    }
+
+    // the tracker sees the preprocessed grayscale frames, time on exactly those
+    Preprocessor preprocess(scale, yaml_node["Preprocess.fused_resize"].as<bool>(false));
+    std::vector<cv::Mat> frames;
+    Frame frame;
+    while (frames.size() < num_frames && video->read(frame)) {
+        if (frame.image.empty()) {
+            continue;
+        }
+        preprocess.process(frame);
+        frames.push_back(preprocess.gray().clone());
+    }
+    if (frames.empty()) {
+        std::cout << "LOG :: AUTOTUNE got no frames" << std::endl;
+        return "";
+    }
+    std::cout << "LOG :: AUTOTUNE on " << frames.size() << " frames of " << frames.front().cols << "x"
+              << frames.front().rows << ", budget " << budget << "[s]" << std::endl;
+
+    const OrbSettings base{yaml_node["Feature.max_num_keypoints"].as<unsigned int>(2000),
+                           yaml_node["Feature.scale_factor"].as<float>(1.2f),
+                           yaml_node["Feature.num_levels"].as<unsigned int>(8),
+                           yaml_node["Feature.ini_fast_threshold"].as<unsigned int>(20),
+                           yaml_node["Feature.min_fast_threshold"].as<unsigned int>(7)};
+    const auto keypoint_counts = yaml_node["AutoTune.keypoints"].as<std::vector<unsigned int>>(
+            std::vector<unsigned int>{500, 1000, 1500, 2000, 3000});
+    const auto level_counts = yaml_node["AutoTune.levels"].as<std::vector<unsigned int>>(
+            std::vector<unsigned int>{4, 6, 8});
+    const auto best = OrbAutoTuner(frames, base).tune(budget, keypoint_counts, level_counts);
+
+    // the rest of the config is kept as is, only the Feature keys change and tuning is switched off
+    YAML::Node tuned = YAML::Clone(yaml_node);
+    tuned["Feature.max_num_keypoints"] = best.max_num_keypoints;
+    tuned["Feature.scale_factor"] = best.scale_factor;
+    tuned["Feature.num_levels"] = best.num_levels;
+    tuned["Feature.ini_fast_threshold"] = best.ini_fast_threshold;
+    tuned["Feature.min_fast_threshold"] = best.min_fast_threshold;
+    tuned["AutoTune.enabled"] = false;
+
+    YAML::Emitter emitter;
+    emitter << tuned;
+    std::ofstream out(output_path);
+    out << "# ORB settings tuned for a " << budget << "[s] extraction budget per frame\n" << emitter.c_str() << "\n";
+    if (!out) {
+        std::cout << "LOG :: AUTOTUNE cannot write " << output_path << std::endl;
+        return "";
+    }
+    std::cout << "LOG :: AUTOTUNE picked " << best.max_num_keypoints << " keypoints, " << best.num_levels
+              << " levels, written to " << output_path << std::endl;
+    return output_path;
+}
+
+#endif
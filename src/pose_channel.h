@@ -0,0 +1,99 @@
+#ifndef OPEN_GL_TEST_POSE_CHANNEL_H
+#define OPEN_GL_TEST_POSE_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <openvslam/type.h>
+
+enum class TrackingState {
+    // SLAM is still starting up, frames pass through untracked
+    starting,
+    // openvslam is building its initial map
+    initializing,
+    tracking,
+    // openvslam lost track and is relocalizing
+    lost,
+    // the tracking loop has ended
+    stopped
+};
+
+// The newest tracking result as the tracker published it
+struct PoseSample {
+    // camera from world, only an estimate for this frame in the tracking state
+    openvslam::Mat44_t pose;
+    double timestamp;
+    unsigned long frame_id;
+    TrackingState state;
+};
+
+// Hands the newest pose from the tracker to any number of consumers without locks.
+//
+// A sequence lock: the single writer makes the sequence number odd, copies the sample in and
+// makes it even again, readers copy the sample out and retry if the sequence number was odd
+// or changed meanwhile. Publishing is a handful of stores and never waits for readers, and
+// readers never block the tracker. The sample is kept in atomic words so the racy copy is
+// well defined.
+class PoseChannel {
+private:
+    static const size_t num_words = (sizeof(PoseSample) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // the writer and readers touch the sequence number on every access, keep it off the payload's lines.
+    // Padding rather than alignas, which C++11 operator new doesn't honour for heap-allocated owners.
+    std::atomic<uint64_t> sequence{0};
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> words[num_words];
+
+public:
+    PoseChannel() {
+        for (auto &word : words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    PoseChannel(const PoseChannel &) = delete;
+
+    PoseChannel &operator=(const PoseChannel &) = delete;
+
+    // Publish a sample, from one thread only
+    void publish(const PoseSample &sample) {
+        uint64_t buffer[num_words] = {};
+        std::memcpy(buffer, &sample, sizeof(sample));
+
+        const uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < num_words; ++i) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Copy out the newest sample. Returns false if nothing was published yet.
+    bool read(PoseSample &sample) const {
+        uint64_t buffer[num_words];
+        uint64_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < num_words; ++i) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        if (before == 0) {
+            return false;
+        }
+        std::memcpy(static_cast<void *>(&sample), buffer, sizeof(sample));
+        return true;
+    }
+
+    // number of samples published so far, to check for a new one without copying it
+    uint64_t version() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+};
+
+#endif
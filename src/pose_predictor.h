@@ -0,0 +1,124 @@
+#ifndef OPEN_GL_TEST_POSE_PREDICTOR_H
+#define OPEN_GL_TEST_POSE_PREDICTOR_H
+
+#include <cmath>
+#include <deque>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <openvslam/type.h>
+
+#include "frame.h"
+
+// Extrapolates camera poses to the time a rendered frame reaches the screen.
+//
+// Keeps a short history of timestamped tracker poses (camera from world), estimates a
+// constant velocity twist on SE(3) between the oldest and newest of them and applies it
+// forward from the newest pose. Overlays drawn at display rate then stay locked to the
+// world between tracking results, and the tracking latency is hidden.
+class PosePredictor {
+private:
+    struct Sample {
+        double timestamp;
+        // kept in a std::deque
+        UnalignedMat44_t pose;
+    };
+
+    typedef Eigen::Matrix<double, 6, 1> Vec6_t;
+
+    const unsigned int history_size;
+    // beyond this horizon the velocity is not trusted, e.g. after tracking stalled
+    const double max_extrapolation;
+
+    std::deque<Sample> history;
+
+    static openvslam::Mat33_t skew(const openvslam::Vec3_t &v) {
+        openvslam::Mat33_t m;
+        m << 0.0, -v(2), v(1),
+                v(2), 0.0, -v(0),
+                -v(1), v(0), 0.0;
+        return m;
+    }
+
+    // left Jacobian of SO(3), maps the translational part of a twist to a translation
+    static openvslam::Mat33_t left_jacobian(const openvslam::Vec3_t &omega) {
+        const double theta = omega.norm();
+        const openvslam::Mat33_t W = skew(omega);
+        if (theta < 1e-8) {
+            return openvslam::Mat33_t::Identity() + 0.5 * W;
+        }
+        const double theta2 = theta * theta;
+        return openvslam::Mat33_t::Identity() + (1.0 - std::cos(theta)) / theta2 * W
+               + (theta - std::sin(theta)) / (theta2 * theta) * W * W;
+    }
+
+    // twist (omega, u) of a rigid transform
+    static Vec6_t log(const openvslam::Mat44_t &T) {
+        const Eigen::AngleAxisd rotation(openvslam::Mat33_t(T.block<3, 3>(0, 0)));
+        const openvslam::Vec3_t omega = rotation.angle() * rotation.axis();
+        Vec6_t xi;
+        xi.head<3>() = omega;
+        xi.tail<3>() = left_jacobian(omega).inverse() * T.block<3, 1>(0, 3);
+        return xi;
+    }
+
+    static openvslam::Mat44_t exp(const Vec6_t &xi) {
+        const openvslam::Vec3_t omega = xi.head<3>();
+        const double theta = omega.norm();
+        openvslam::Mat44_t T = openvslam::Mat44_t::Identity();
+        if (theta > 1e-12) {
+            T.block<3, 3>(0, 0) = Eigen::AngleAxisd(theta, omega / theta).toRotationMatrix();
+        }
+        T.block<3, 1>(0, 3) = left_jacobian(omega) * xi.tail<3>();
+        return T;
+    }
+
+    static openvslam::Mat44_t inverse(const openvslam::Mat44_t &T) {
+        openvslam::Mat44_t inv = openvslam::Mat44_t::Identity();
+        const openvslam::Mat33_t R_t = T.block<3, 3>(0, 0).transpose();
+        inv.block<3, 3>(0, 0) = R_t;
+        inv.block<3, 1>(0, 3) = -R_t * T.block<3, 1>(0, 3);
+        return inv;
+    }
+
+public:
+    PosePredictor(const unsigned int history_size, const double max_extrapolation)
+            : history_size(history_size < 2 ? 2 : history_size), max_extrapolation(max_extrapolation) {}
+
+    // Record the tracker's pose for the frame captured at timestamp
+    void add(const double timestamp, const openvslam::Mat44_t &pose) {
+        if (!history.empty() && timestamp <= history.back().timestamp) {
+            // out of order or repeated, restart rather than extrapolate through a jump
+            history.clear();
+        }
+        history.push_back(Sample{timestamp, pose});
+        while (history.size() > history_size) {
+            history.pop_front();
+        }
+    }
+
+    void reset() {
+        history.clear();
+    }
+
+    bool empty() const {
+        return history.empty();
+    }
+
+    // Pose expected at time t, in the clock of the frame timestamps
+    openvslam::Mat44_t predict(const double t) const {
+        const Sample &newest = history.back();
+        const double ahead = t - newest.timestamp;
+        if (history.size() < 2 || ahead <= 0.0 || ahead > max_extrapolation) {
+            return newest.pose;
+        }
+
+        // T_newest = D * T_oldest, spread D evenly over the time between them
+        const Sample &oldest = history.front();
+        const openvslam::Mat44_t delta = newest.pose * inverse(oldest.pose);
+        const Vec6_t velocity = log(delta) / (newest.timestamp - oldest.timestamp);
+        return exp(velocity * ahead) * newest.pose;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef OPEN_GL_TEST_PREPROCESS_H
+#define OPEN_GL_TEST_PREPROCESS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "frame.h"
+
+// BT.601 limited range YUV to BGR for one row, with 10 bit fixed point coefficients.
+// u and v advance by uv_step bytes per chroma sample: 1 for I420 planes, 2 for NV12.
+inline void yuv_row_to_bgr(const uchar *y, const uchar *u, const uchar *v, const int uv_step,
+                           uchar *bgr, const int cols) {
+    for (int x = 0; x < cols; ++x) {
+        const int c = 1192 * (std::max(y[x] - 16, 0));
+        const int d = u[(x / 2) * uv_step] - 128;
+        const int e = v[(x / 2) * uv_step] - 128;
+        const int b = (c + 2066 * d + 512) >> 10;
+        const int g = (c - 401 * d - 832 * e + 512) >> 10;
+        const int r = (c + 1634 * e + 512) >> 10;
+        bgr[3 * x + 0] = static_cast<uchar>(std::min(std::max(b, 0), 255));
+        bgr[3 * x + 1] = static_cast<uchar>(std::min(std::max(g, 0), 255));
+        bgr[3 * x + 2] = static_cast<uchar>(std::min(std::max(r, 0), 255));
+    }
+}
+
+// Convert a YUV frame to packed BGR at full resolution
+inline void yuv_to_bgr(const Frame &frame, cv::Mat &bgr) {
+    bgr.create(frame.image.rows, frame.image.cols, CV_8UC3);
+    cv::parallel_for_(cv::Range(0, frame.image.rows), [&](const cv::Range &range) {
+        for (int row = range.start; row < range.end; ++row) {
+            const uchar *y = frame.image.ptr<uchar>(row);
+            uchar *out = bgr.ptr<uchar>(row);
+            if (frame.format == PixelFormat::nv12) {
+                const uchar *uv = frame.chroma[0].ptr<uchar>(row / 2);
+                yuv_row_to_bgr(y, uv, uv + 1, 2, out, frame.image.cols);
+            } else {
+                yuv_row_to_bgr(y, frame.chroma[0].ptr<uchar>(row / 2), frame.chroma[1].ptr<uchar>(row / 2), 1,
+                               out, frame.image.cols);
+            }
+        }
+    });
+}
+
+// Turns a captured BGR frame into the grayscale image fed to the tracker and the
+// colour image drawn on screen, downscaling both on the way.
+//
+// Without downscaling this is cv::cvtColor. Downscaling is cv::resize followed by
+// cv::cvtColor unless the fused pass is chosen, which produces every output row in one
+// pass instead of walking the full frame twice: the two source rows it needs are resampled
+// horizontally into small per-stripe buffers, then blended vertically into the colour row
+// and converted to gray while that row is still in cache. Output images, sampling tables
+// and row buffers are kept between frames, so a frame of unchanged size allocates nothing.
+//
+// The vertical blend and the gray conversion of the fused pass use OpenCV's universal
+// intrinsics where the build has 128 bit SIMD. The horizontal pass gathers through the
+// sampling table and stays scalar, which leaves the fused pass slower than OpenCV's own
+// resize on the hosts measured so far; bench/preprocess_bench tells for a given host.
+//
+// YUV frames already carry luma, so their Y plane goes to the tracker as is
+// and only the display image needs a colour conversion, which can be left to
+// a renderer that converts YUV itself.
+class Preprocessor {
+private:
+    // fixed point precision of the interpolation weights, same as cv::resize
+    static const int weight_bits = 11;
+    static const int weight_one = 1 << weight_bits;
+
+    const float scale;
+    // downscale BGR frames with the fused pass instead of cv::resize and cv::cvtColor
+    const bool fused;
+    bool convert_yuv = true;
+
+    cv::Mat gray_image;
+    cv::Mat color_image;
+
+    // horizontal sampling table for the current input width:
+    // byte offsets of the left and right source pixel and the weight of the right one
+    int table_src_cols = -1;
+    std::vector<int> x_left;
+    std::vector<int> x_right;
+    std::vector<int> x_weight;
+
+    // two resampled source rows per stripe of output rows, see resize_rows()
+    std::vector<int> row_buffers;
+
+    void build_table(const int src_cols, const int dst_cols) {
+        table_src_cols = src_cols;
+        x_left.resize(dst_cols);
+        x_right.resize(dst_cols);
+        x_weight.resize(dst_cols);
+
+        const float inv_scale = static_cast<float>(src_cols) / dst_cols;
+        for (int x = 0; x < dst_cols; ++x) {
+            // align pixel centres the way cv::resize does with INTER_LINEAR
+            float sx = (x + 0.5f) * inv_scale - 0.5f;
+            int left = static_cast<int>(std::floor(sx));
+            float frac = sx - left;
+            if (left < 0) {
+                left = 0;
+                frac = 0.0f;
+            }
+            if (left >= src_cols - 1) {
+                left = src_cols - 1;
+                frac = 0.0f;
+            }
+            x_left[x] = left * 3;
+            x_right[x] = std::min(left + 1, src_cols - 1) * 3;
+            x_weight[x] = static_cast<int>(frac * weight_one + 0.5f);
+        }
+    }
+
+    // horizontal pass of one source row into weight_one-scaled intermediate values
+    void resample_row(const uchar *src, int *dst, const int dst_cols) const {
+        for (int x = 0; x < dst_cols; ++x) {
+            const uchar *l = src + x_left[x];
+            const uchar *r = src + x_right[x];
+            const int wr = x_weight[x];
+            const int wl = weight_one - wr;
+            dst[3 * x + 0] = l[0] * wl + r[0] * wr;
+            dst[3 * x + 1] = l[1] * wl + r[1] * wr;
+            dst[3 * x + 2] = l[2] * wl + r[2] * wr;
+        }
+    }
+
+    // BT.601 luma from BGR with 8 bit weights, within one level of cv::cvtColor
+    static void bgr_row_to_gray(const uchar *bgr, uchar *gray, const int cols) {
+        int x = 0;
+#if CV_SIMD128
+        const cv::v_uint16x8 wb = cv::v_setall_u16(29);
+        const cv::v_uint16x8 wg = cv::v_setall_u16(150);
+        const cv::v_uint16x8 wr = cv::v_setall_u16(77);
+        const cv::v_uint16x8 round = cv::v_setall_u16(128);
+        // the weights sum to 256, so no intermediate leaves 16 bits
+        for (; x <= cols - 16; x += 16) {
+            cv::v_uint8x16 b, g, r;
+            cv::v_load_deinterleave(bgr + 3 * x, b, g, r);
+            cv::v_uint16x8 b0, b1, g0, g1, r0, r1;
+            cv::v_expand(b, b0, b1);
+            cv::v_expand(g, g0, g1);
+            cv::v_expand(r, r0, r1);
+            const cv::v_uint16x8 y0 = (b0 * wb + g0 * wg + r0 * wr + round) >> 8;
+            const cv::v_uint16x8 y1 = (b1 * wb + g1 * wg + r1 * wr + round) >> 8;
+            cv::v_store(gray + x, cv::v_pack(y0, y1));
+        }
+#endif
+        for (; x < cols; ++x) {
+            gray[x] = static_cast<uchar>((bgr[3 * x] * 29 + bgr[3 * x + 1] * 150 + bgr[3 * x + 2] * 77 + 128) >> 8);
+        }
+    }
+
+    // Output rows begin to end, resampling source rows into the two dst_cols * 3 rows at buffers
+    void resize_rows(const cv::Mat &src, const int begin, const int end, int *buffers) {
+        const int dst_cols = color_image.cols;
+        const float inv_scale = static_cast<float>(src.rows) / color_image.rows;
+
+        int *top = buffers;
+        int *bottom = buffers + dst_cols * 3;
+        int top_row = -1;
+        int bottom_row = -1;
+
+        for (int y = begin; y < end; ++y) {
+            float sy = (y + 0.5f) * inv_scale - 0.5f;
+            int y0 = static_cast<int>(std::floor(sy));
+            float frac = sy - y0;
+            if (y0 < 0) {
+                y0 = 0;
+                frac = 0.0f;
+            }
+            if (y0 >= src.rows - 1) {
+                y0 = src.rows - 1;
+                frac = 0.0f;
+            }
+            const int y1 = std::min(y0 + 1, src.rows - 1);
+            const int wb = static_cast<int>(frac * weight_one + 0.5f);
+            const int wt = weight_one - wb;
+
+            // consecutive output rows mostly share source rows, only resample what is new
+            if (top_row != y0) {
+                if (bottom_row == y0) {
+                    std::swap(top, bottom);
+                    std::swap(top_row, bottom_row);
+                } else {
+                    resample_row(src.ptr<uchar>(y0), top, dst_cols);
+                    top_row = y0;
+                }
+            }
+            if (bottom_row != y1) {
+                resample_row(src.ptr<uchar>(y1), bottom, dst_cols);
+                bottom_row = y1;
+            }
+
+            blend_rows(top, bottom, wt, wb, color_image.ptr<uchar>(y), dst_cols * 3);
+            bgr_row_to_gray(color_image.ptr<uchar>(y), gray_image.ptr<uchar>(y), dst_cols);
+        }
+    }
+
+    // vertical pass: weight two resampled rows and scale back to 8 bits
+    static void blend_rows(const int *top, const int *bottom, const int wt, const int wb, uchar *dst,
+                           const int count) {
+        const int round = 1 << (2 * weight_bits - 1);
+        int i = 0;
+#if CV_SIMD128
+        const cv::v_int32x4 vwt = cv::v_setall_s32(wt);
+        const cv::v_int32x4 vwb = cv::v_setall_s32(wb);
+        const cv::v_int32x4 vround = cv::v_setall_s32(round);
+        for (; i <= count - 16; i += 16) {
+            cv::v_int32x4 v[4];
+            for (int k = 0; k < 4; ++k) {
+                v[k] = (cv::v_load(top + i + 4 * k) * vwt + cv::v_load(bottom + i + 4 * k) * vwb + vround)
+                        >> (2 * weight_bits);
+            }
+            cv::v_store(dst + i, cv::v_pack_u(cv::v_pack(v[0], v[1]), cv::v_pack(v[2], v[3])));
+        }
+#endif
+        for (; i < count; ++i) {
+            dst[i] = static_cast<uchar>((top[i] * wt + bottom[i] * wb + round) >> (2 * weight_bits));
+        }
+    }
+
+    void process_yuv(const Frame &frame) {
+        if (scale == 1.0f) {
+            gray_image = frame.image;
+        } else {
+            cv::resize(frame.image, gray_image, cv::Size(), scale, scale, cv::INTER_LINEAR);
+        }
+        if (!convert_yuv) {
+            color_image.release();
+            return;
+        }
+        // the window is sized for the full frame, so display needs no downscale
+        yuv_to_bgr(frame, color_image);
+    }
+
+public:
+    explicit Preprocessor(const float scale, const bool fused = false) : scale(scale), fused(fused) {}
+
+    // Whether YUV frames get a BGR colour image. Without it color() stays empty for them
+    // and the frame's planes are what there is to display.
+    void set_convert_yuv(const bool convert) {
+        convert_yuv = convert;
+    }
+
+    // Process a captured frame of any pixel format. The results stay valid until the
+    // next call and may share pixels with the input frame.
+    void process(const Frame &frame) {
+        if (frame.format == PixelFormat::bgr) {
+            process(frame.image);
+        } else {
+            process_yuv(frame);
+        }
+    }
+
+    // Process a CV_8UC3 BGR image. With scale 1 the colour image shares the input's pixels.
+    void process(const cv::Mat &bgr) {
+        if (scale == 1.0f) {
+            // there is no resize to fuse with, and OpenCV's own conversion is vectorised and parallel
+            color_image = bgr;
+            cv::cvtColor(bgr, gray_image, cv::COLOR_BGR2GRAY);
+            return;
+        }
+
+        const int dst_rows = std::max(1, static_cast<int>(std::lround(bgr.rows * scale)));
+        const int dst_cols = std::max(1, static_cast<int>(std::lround(bgr.cols * scale)));
+        if (!fused) {
+            cv::resize(bgr, color_image, cv::Size(dst_cols, dst_rows), 0, 0, cv::INTER_LINEAR);
+            cv::cvtColor(color_image, gray_image, cv::COLOR_BGR2GRAY);
+            return;
+        }
+
+        color_image.create(dst_rows, dst_cols, CV_8UC3);
+        gray_image.create(dst_rows, dst_cols, CV_8UC1);
+        if (table_src_cols != bgr.cols || static_cast<int>(x_left.size()) != dst_cols) {
+            build_table(bgr.cols, dst_cols);
+        }
+
+        // one stripe of rows per worker thread, each with its own pair of row buffers
+        const int stripes = std::max(1, std::min(cv::getNumThreads(), dst_rows));
+        const size_t stripe_buffers = static_cast<size_t>(dst_cols) * 3 * 2;
+        row_buffers.resize(stripes * stripe_buffers);
+
+        cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range &range) {
+            for (int stripe = range.start; stripe < range.end; ++stripe) {
+                resize_rows(bgr, stripe * dst_rows / stripes, (stripe + 1) * dst_rows / stripes,
+                            row_buffers.data() + stripe * stripe_buffers);
+            }
+        });
+    }
+
+    // single channel image for the tracker
+    const cv::Mat &gray() const {
+        return gray_image;
+    }
+
+    // BGR image for display, empty for YUV frames when their conversion is off
+    const cv::Mat &color() const {
+        return color_image;
+    }
+};
+
+#endif
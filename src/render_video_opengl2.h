@@ -3,6 +3,7 @@
 #include <unistd.h>
 
 #include <iostream>
+#include <memory>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -11,6 +12,10 @@
 
 #include <opencv2/opencv.hpp>
 #include <Eigen/src/Core/Matrix.h>
+
+#include "camera_texture.h"
+#include "frame.h"
+#include "shader.h"
 //#include <glm/detail/qualifier.hpp>
 //#include <glm/detail/type_mat4x2.hpp>
 
@@ -20,62 +25,21 @@ using std::endl;
 int window_width = 640;
 int window_height = 480;
 
-// Function turn a cv::Mat into a texture, and return the texture ID as a GLuint for use
-static GLuint matToTexture(const cv::Mat &mat, GLenum minFilter, GLenum magFilter, GLenum wrapFilter) {
-    // Generate a number for our textureID's unique handle
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-
-    // Bind to our texture handle
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Catch silly-mistake texture interpolation method for magnification
-    if (magFilter == GL_LINEAR_MIPMAP_LINEAR ||
-        magFilter == GL_LINEAR_MIPMAP_NEAREST ||
-        magFilter == GL_NEAREST_MIPMAP_LINEAR ||
-        magFilter == GL_NEAREST_MIPMAP_NEAREST) {
-        cout << "You can't use MIPMAPs for magnification - setting filter to GL_LINEAR" << endl;
-        magFilter = GL_LINEAR;
-    }
-
-    // Set texture interpolation methods for minification and magnification
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-
-    // Set texture clamping method
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapFilter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapFilter);
-
-    // Set incoming texture format to:
-    // GL_BGR       for CV_CAP_OPENNI_BGR_IMAGE,
-    // GL_LUMINANCE for CV_CAP_OPENNI_DISPARITY_MAP,
-    // Work out other mappings as required ( there's a list in comments in main() )
-    GLenum inputColourFormat = GL_BGR;
-    if (mat.channels() == 1) {
-        inputColourFormat = GL_LUMINANCE;
-    }
+// Pinhole intrinsics of the tracked camera and the image size they were calibrated for
+struct CameraIntrinsics {
+    double fx, fy, cx, cy;
+    double cols, rows;
+};
+CameraIntrinsics intrinsics = {500.0, 500.0, 320.0, 240.0, 640.0, 480.0};
 
-    // Create the texture
-    glTexImage2D(GL_TEXTURE_2D,     // Type of texture
-                 0,                 // Pyramid level (for mip-mapping) - 0 is the top level
-                 GL_RGB,            // Internal colour format to convert to
-                 mat.cols,          // Image width  i.e. 640 for Kinect in standard mode
-                 mat.rows,          // Image height i.e. 480 for Kinect in standard mode
-                 0,                 // Border width in pixels (can either be 1 or 0)
-                 inputColourFormat, // Input image format (i.e. GL_RGB, GL_RGBA, GL_BGR etc.)
-                 GL_UNSIGNED_BYTE,  // Image data type
-                 mat.ptr());        // The actual image data itself
-
-    // If we're using mipmaps then generate them. Note: This requires OpenGL 3.0 or higher
-    if (minFilter == GL_LINEAR_MIPMAP_LINEAR ||
-        minFilter == GL_LINEAR_MIPMAP_NEAREST ||
-        minFilter == GL_NEAREST_MIPMAP_LINEAR ||
-        minFilter == GL_NEAREST_MIPMAP_NEAREST) {
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
+// allocated at the first frame and updated in place after that
+CameraTexture camera_texture;
 
-    return textureID;
-}
+// Planes of YUV frames, Y on texture unit 0 and the chroma on units 1 and 2, and the program
+// converting them to colour. Chroma is sampled at half resolution, filtering interpolates it.
+CameraTexture luma_texture;
+CameraTexture chroma_textures[2];
+std::unique_ptr<Shader> yuv_shader;
 
 static void error_callback(int error, const char *description) {
     fprintf(stderr, "Error: %s\n", description);
@@ -95,13 +59,52 @@ static void resize_callback(GLFWwindow *window, int new_width, int new_height) {
     glMatrixMode(GL_MODELVIEW);
 }
 
-static void draw_frame(const cv::Mat &frame) {
+static void upload_or_bind(CameraTexture &texture, const cv::Mat &image, bool changed) {
+    if (changed) {
+        texture.upload(image);
+    } else {
+        texture.bind();
+    }
+}
+
+// Bind the planes of a YUV frame and the program converting them, uploading them first if the frame changed
+static void bind_yuv_frame(const Frame &frame, bool frame_changed) {
+    if (!yuv_shader) {
+        yuv_shader.reset(new Shader("cam_yuv_vertex.vs", "cam_yuv_fragment.fs"));
+        yuv_shader->use();
+        yuv_shader->setInt("yPlane", 0);
+        yuv_shader->setInt("uPlane", 1);
+        yuv_shader->setInt("vPlane", 2);
+    }
+    const bool interleaved = frame.format == PixelFormat::nv12;
+
+    glActiveTexture(GL_TEXTURE0);
+    upload_or_bind(luma_texture, frame.image, frame_changed);
+    glActiveTexture(GL_TEXTURE1);
+    upload_or_bind(chroma_textures[0], frame.chroma[0], frame_changed);
+    if (!interleaved) {
+        glActiveTexture(GL_TEXTURE2);
+        upload_or_bind(chroma_textures[1], frame.chroma[1], frame_changed);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    yuv_shader->use();
+    yuv_shader->setBool("interleaved", interleaved);
+}
+
+// Draw the camera image, uploading it first if it changed since the last call
+static void draw_frame(const Frame &frame, bool frame_changed) {
     // Clear color and depth buffers
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);     // Operate on model-view matrix
 
     glEnable(GL_TEXTURE_2D);
-    GLuint image_tex = matToTexture(frame, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP);
+    const bool yuv = frame.format != PixelFormat::bgr;
+    if (yuv) {
+        bind_yuv_frame(frame, frame_changed);
+    } else {
+        upload_or_bind(camera_texture, frame.image, frame_changed);
+    }
 
     /* Draw a quad */
     glBegin(GL_QUADS);
@@ -115,10 +118,61 @@ static void draw_frame(const cv::Mat &frame) {
     glVertex2i(window_width, 0);
     glEnd();
 
-    glDeleteTextures(1, &image_tex);
+    if (yuv) {
+        // back to fixed function for the overlay
+        glUseProgram(0);
+    }
     glDisable(GL_TEXTURE_2D);
 }
 
+// Draw the world axes over the camera image, as seen from pose (camera from world)
+static void draw_world_axes(const openvslam::Mat44_t &pose) {
+    const double near = 0.01;
+    const double far = 100.0;
+    const double w = intrinsics.cols;
+    const double h = intrinsics.rows;
+
+    // OpenGL projection matching the camera intrinsics, column major
+    const GLdouble proj[16] = {2.0 * intrinsics.fx / w, 0.0, 0.0, 0.0,
+                               0.0, 2.0 * intrinsics.fy / h, 0.0, 0.0,
+                               1.0 - 2.0 * intrinsics.cx / w, 2.0 * intrinsics.cy / h - 1.0,
+                               -(far + near) / (far - near), -1.0,
+                               0.0, 0.0, -2.0 * far * near / (far - near), 0.0};
+
+    // OpenCV camera axes (y down, z forward) to OpenGL ones (y up, z backward)
+    openvslam::Mat44_t view = pose;
+    view.row(1) *= -1.0;
+    view.row(2) *= -1.0;
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixd(proj);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixd(view.data());
+
+    const float length = 0.3f;
+    glLineWidth(3.0f);
+    glBegin(GL_LINES);
+    glColor3f(1.0f, 0.0f, 0.0f);
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(length, 0.0f, 0.0f);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(0.0f, length, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(0.0f, 0.0f, length);
+    glEnd();
+    // the camera image is modulated by the current colour
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
 static void init_opengl(int w, int h) {
     glViewport(0, 0, w, h); // use a screen size of WIDTH x HEIGHT
 
@@ -223,14 +277,72 @@ void setup() {
 
 }
 
-void update(cv::Mat &frame,  openvslam::Mat44_t &pose) {
-    draw_frame(frame);
+// Match the window to the video once its size is known
+void resize_window(int w, int h) {
+    glfwSetWindowSize(window, w, h);
+    resize_callback(window, w, h);
+}
+
+void set_camera_intrinsics(double fx, double fy, double cx, double cy, int cols, int rows) {
+    intrinsics = {fx, fy, cx, cy, static_cast<double>(cols), static_cast<double>(rows)};
+}
+
+// Time between two vertical blanks of the primary monitor
+double display_refresh_interval() {
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    return mode && mode->refreshRate > 0 ? 1.0 / mode->refreshRate : 1.0 / 60.0;
+}
+
+// Number of pixel buffers camera frames are streamed through, 0 uploads them directly
+void set_texture_upload_buffers(unsigned int num) {
+    camera_texture.set_upload_buffers(num);
+    luma_texture.set_upload_buffers(num);
+    chroma_textures[0].set_upload_buffers(num);
+    chroma_textures[1].set_upload_buffers(num);
+}
+
+// Frames backed by a persistently mapped GPU buffer, to be filled by other threads and drawn
+// without a copy. Empty if the driver can't map buffers persistently.
+std::vector<cv::Mat> map_display_frames(unsigned int count, int rows, int cols, int type) {
+    return camera_texture.map_frames(count, rows, cols, type);
+}
+
+// Call before a drawn frame is handed back to be overwritten
+void finish_with_frame(const cv::Mat &frame) {
+    camera_texture.finish_with(frame);
+}
+
+void print_render_stats() {
+    if (yuv_shader) {
+        std::cout << "luma ";
+        luma_texture.print_stats();
+    } else {
+        camera_texture.print_stats();
+    }
+}
+
+// Draw the frame, BGR or YUV, with the world axes overlaid at pose when draw_overlay is set.
+// frame_changed is false when the same frame is drawn again, e.g. with a new pose.
+void update(const Frame &frame, const openvslam::Mat44_t &pose, bool draw_overlay, bool frame_changed) {
+    draw_frame(frame, frame_changed);
+    if (draw_overlay) {
+        draw_world_axes(pose);
+    }
 
     glfwSwapBuffers(window);
     glfwPollEvents();
 }
 
 void terminate() {
+    // the texture belongs to the context, free it while that is still current
+    camera_texture.release();
+    luma_texture.release();
+    chroma_textures[0].release();
+    chroma_textures[1].release();
+    if (yuv_shader) {
+        glDeleteProgram(yuv_shader->ID);
+        yuv_shader.reset();
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
 
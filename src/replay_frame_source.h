@@ -0,0 +1,327 @@
+#ifndef OPEN_GL_TEST_REPLAY_FRAME_SOURCE_H
+#define OPEN_GL_TEST_REPLAY_FRAME_SOURCE_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "frame_ring.h"
+#include "frame_source.h"
+
+// A recorded session is a directory holding one image per frame and a
+// timestamps.txt index with one "<image file> <timestamp> [<pixel format>]" line per frame.
+//
+// YUV frames are stored as one 8 bit image, the luma plane on top and the chroma planes
+// below it: U and V side by side for I420, the interleaved UV rows for NV12. Images are
+// lossless, so a replay hands the tracker the exact Y plane the live run saw.
+
+inline const char *pixel_format_name(const PixelFormat format) {
+    switch (format) {
+        case PixelFormat::i420:
+            return "i420";
+        case PixelFormat::nv12:
+            return "nv12";
+        default:
+            return "bgr";
+    }
+}
+
+inline PixelFormat pixel_format_from_name(const std::string &name) {
+    if (name == "i420") {
+        return PixelFormat::i420;
+    }
+    if (name == "nv12") {
+        return PixelFormat::nv12;
+    }
+    return PixelFormat::bgr;
+}
+
+// rows and cols of the single image a rows x cols YUV 4:2:0 frame is recorded as
+inline cv::Size packed_yuv_size(const int rows, const int cols) {
+    return cv::Size(2 * ((cols + 1) / 2), rows + (rows + 1) / 2);
+}
+
+inline void pack_yuv(const Frame &frame, cv::Mat &packed) {
+    const int rows = frame.image.rows;
+    const int cols = frame.image.cols;
+    const int chroma_rows = (rows + 1) / 2;
+    const int chroma_cols = (cols + 1) / 2;
+    packed.create(packed_yuv_size(rows, cols), CV_8UC1);
+
+    frame.image.copyTo(packed(cv::Rect(0, 0, cols, rows)));
+    if (frame.format == PixelFormat::nv12) {
+        frame.chroma[0].copyTo(packed.rowRange(rows, rows + chroma_rows).reshape(2));
+    } else {
+        frame.chroma[0].copyTo(packed(cv::Rect(0, rows, chroma_cols, chroma_rows)));
+        frame.chroma[1].copyTo(packed(cv::Rect(chroma_cols, rows, chroma_cols, chroma_rows)));
+    }
+}
+
+// Point frame's planes into packed, which keeps them alive
+inline void unpack_yuv(const cv::Mat &packed, const PixelFormat format, Frame &frame) {
+    // inverse of packed_yuv_size(), recorded widths are even
+    const int rows = 2 * packed.rows / 3;
+    const int cols = packed.cols;
+    const int chroma_rows = packed.rows - rows;
+    const int chroma_cols = cols / 2;
+
+    frame.format = format;
+    frame.image = packed.rowRange(0, rows);
+    if (format == PixelFormat::nv12) {
+        frame.chroma[0] = packed.rowRange(rows, rows + chroma_rows).reshape(2);
+        frame.chroma[1].release();
+    } else {
+        frame.chroma[0] = packed(cv::Rect(0, rows, chroma_cols, chroma_rows));
+        frame.chroma[1] = packed(cv::Rect(chroma_cols, rows, chroma_cols, chroma_rows));
+    }
+}
+
+// Plays back a recorded session, either paced like the live capture was or as fast as
+// frames can be decoded. Paced replays are live, their timestamps keep the recorded
+// spacing but are moved onto the monotonic clock like a camera's, so the renderer can
+// extrapolate poses to now. Unpaced ones keep the recorded timestamps bit for bit.
+class ReplayFrameSource : public FrameSource {
+private:
+    struct Entry {
+        std::string file;
+        double timestamp;
+        PixelFormat format;
+    };
+
+    const std::string directory;
+    const bool realtime;
+
+    std::vector<Entry> entries;
+    unsigned int next = 0;
+
+    int frame_width = 0;
+    int frame_height = 0;
+    int frame_type = CV_8UC3;
+    PixelFormat frame_format = PixelFormat::bgr;
+
+    // wall clock time at which the first frame was delivered
+    std::chrono::steady_clock::time_point start;
+    // and the same in seconds of monotonic_now()
+    double start_time = 0.0;
+
+public:
+    ReplayFrameSource(const std::string &directory, const bool realtime)
+            : directory(directory), realtime(realtime) {
+        std::ifstream index(directory + "/timestamps.txt");
+        std::string line;
+        while (std::getline(index, line)) {
+            std::istringstream fields(line);
+            Entry entry;
+            std::string format = "bgr";
+            if (fields >> entry.file >> entry.timestamp) {
+                // sessions recorded before YUV support have no format column
+                fields >> format;
+                entry.format = pixel_format_from_name(format);
+                entries.push_back(entry);
+            }
+        }
+        if (entries.empty()) {
+            std::cout << "No recorded frames in " << directory << std::endl;
+            return;
+        }
+
+        const cv::Mat first = cv::imread(directory + "/" + entries.front().file, cv::IMREAD_UNCHANGED);
+        frame_format = entries.front().format;
+        if (frame_format == PixelFormat::bgr) {
+            frame_width = first.cols;
+            frame_height = first.rows;
+            frame_type = first.type();
+        } else {
+            Frame planes;
+            unpack_yuv(first, frame_format, planes);
+            frame_width = planes.image.cols;
+            frame_height = planes.image.rows;
+            frame_type = CV_8UC1;
+        }
+        std::cout << "Replaying " << entries.size() << " frames from " << directory
+                  << (realtime ? " in real time" : " as fast as possible") << std::endl;
+    }
+
+    bool is_opened() const override {
+        return frame_width > 0;
+    }
+
+    // when not paced, nothing may be dropped or the run is not reproducible
+    bool is_live() const override {
+        return realtime;
+    }
+
+    int width() const override {
+        return frame_width;
+    }
+
+    int height() const override {
+        return frame_height;
+    }
+
+    int type() const override {
+        return frame_type;
+    }
+
+    PixelFormat format() const override {
+        return frame_format;
+    }
+
+    bool read(Frame &frame) override {
+        if (next >= entries.size()) {
+            return false;
+        }
+        const Entry &entry = entries[next];
+
+        const cv::Mat image = cv::imread(directory + "/" + entry.file, cv::IMREAD_UNCHANGED);
+        if (entry.format == PixelFormat::bgr || image.empty()) {
+            frame.format = PixelFormat::bgr;
+            frame.image = image;
+        } else {
+            unpack_yuv(image, entry.format, frame);
+        }
+        frame.timestamp = entry.timestamp;
+
+        if (realtime) {
+            if (next == 0) {
+                start = std::chrono::steady_clock::now();
+                start_time = std::chrono::duration_cast<std::chrono::duration<double>>(
+                        start.time_since_epoch()).count();
+            } else {
+                const auto offset = std::chrono::duration<double>(entry.timestamp - entries.front().timestamp);
+                std::this_thread::sleep_until(
+                        start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+            }
+            frame.timestamp = start_time + (entry.timestamp - entries.front().timestamp);
+        }
+
+        ++next;
+        return !frame.image.empty();
+    }
+};
+
+// Wraps another source and writes every frame it delivers into a session directory
+// that ReplayFrameSource can play back later. Frames are written losslessly so that
+// replays of the same session feed the tracker identical pixels.
+//
+// The capture thread only copies each frame into a queue, PNG encoding and disk writes
+// happen on a writer thread of their own so recording doesn't change the capture timing
+// it records. No frame may go missing from a recording, so a full queue makes capture
+// wait; the time it waited is printed when recording ends.
+class RecordingFrameSource : public FrameSource {
+private:
+    std::unique_ptr<FrameSource> source;
+    const std::string directory;
+
+    std::ofstream index;
+    unsigned long num_recorded = 0;
+
+    FrameRing queue;
+    // copy of the latest frame, swapped into the queue
+    Frame pending;
+    std::thread writer;
+
+    // size and type of the images frames of source are recorded as
+    static cv::Size recorded_size(const FrameSource &source) {
+        return source.format() == PixelFormat::bgr ? cv::Size(source.width(), source.height())
+                                                    : packed_yuv_size(source.height(), source.width());
+    }
+
+    static int recorded_type(const FrameSource &source) {
+        return source.format() == PixelFormat::bgr ? source.type() : CV_8UC1;
+    }
+
+    void write_frames() {
+        Frame frame;
+        while (queue.pop(frame)) {
+            char file[32];
+            snprintf(file, sizeof(file), "%06lu.png", num_recorded++);
+            // lowest compression level, keeps up with the camera on a single core
+            cv::imwrite(directory + "/" + file, frame.image, {cv::IMWRITE_PNG_COMPRESSION, 1});
+            index << file << " " << frame.timestamp << " " << pixel_format_name(frame.format) << "\n";
+        }
+    }
+
+public:
+    RecordingFrameSource(std::unique_ptr<FrameSource> source, const std::string &directory,
+                         const unsigned int queue_size = 32)
+            : source(std::move(source)), directory(directory), queue(queue_size, OverflowPolicy::block, recorded_size(*this->source).height,
+                                                                  recorded_size(*this->source).width,
+                                                                  recorded_type(*this->source)) {
+        mkdir(directory.c_str(), 0755);
+        index.open(directory + "/timestamps.txt");
+        if (!index) {
+            std::cout << "Cannot record session into " << directory << std::endl;
+            return;
+        }
+        // keep full precision, timestamps are compared frame for frame on replay
+        index.precision(17);
+        writer = std::thread(&RecordingFrameSource::write_frames, this);
+    }
+
+    ~RecordingFrameSource() {
+        // queued frames are still written
+        queue.close();
+        if (writer.joinable()) {
+            writer.join();
+            queue.print("recording");
+        }
+    }
+
+    bool is_opened() const override {
+        return source->is_opened();
+    }
+
+    bool is_live() const override {
+        return source->is_live();
+    }
+
+    int width() const override {
+        return source->width();
+    }
+
+    int height() const override {
+        return source->height();
+    }
+
+    int type() const override {
+        return source->type();
+    }
+
+    PixelFormat format() const override {
+        return source->format();
+    }
+
+    void interrupt() override {
+        source->interrupt();
+    }
+
+    bool read(Frame &frame) override {
+        if (!source->read(frame)) {
+            return false;
+        }
+        if (writer.joinable() && !frame.image.empty()) {
+            if (frame.format == PixelFormat::bgr) {
+                frame.image.copyTo(pending.image);
+            } else {
+                pack_yuv(frame, pending.image);
+            }
+            pending.format = frame.format;
+            pending.timestamp = frame.timestamp;
+            queue.push(pending);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef OPEN_GL_TEST_THREAD_POLICY_H
+#define OPEN_GL_TEST_THREAD_POLICY_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <yaml-cpp/yaml.h>
+
+// CPU set and scheduling of one pipeline thread, from the Threads.<role>.* keys of the config
+struct ThreadPolicy {
+    std::string role;
+    // CPUs the thread may run on, empty leaves the affinity alone
+    std::vector<int> cpus;
+    // SCHED_FIFO priority (1-99), 0 keeps the default time-sharing scheduler
+    int fifo_priority = 0;
+
+    bool empty() const {
+        return cpus.empty() && fifo_priority == 0;
+    }
+
+    std::string describe() const {
+        std::ostringstream out;
+        out << "CPUs {";
+        for (unsigned int i = 0; i < cpus.size(); ++i) {
+            out << (i ? "," : "") << cpus[i];
+        }
+        out << "}";
+        if (fifo_priority > 0) {
+            out << " SCHED_FIFO " << fifo_priority;
+        }
+        return out.str();
+    }
+};
+
+inline ThreadPolicy thread_policy_from_yaml(const YAML::Node &yaml_node, const std::string &role) {
+    ThreadPolicy policy;
+    policy.role = role;
+    policy.cpus = yaml_node["Threads." + role + ".cpus"].as<std::vector<int>>(std::vector<int>());
+    policy.fifo_priority = yaml_node["Threads." + role + ".fifo_priority"].as<int>(0);
+    return policy;
+}
+
+namespace thread_policy_detail {
+
+inline cpu_set_t to_cpu_set(const std::vector<int> &cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return set;
+}
+
+// Check an affinity and scheduler read back from a thread against the policy
+inline bool matches(const ThreadPolicy &policy, const cpu_set_t &actual_cpus, const int actual_scheduler,
+                    const int actual_priority) {
+    if (!policy.cpus.empty()) {
+        cpu_set_t wanted = to_cpu_set(policy.cpus);
+        if (!CPU_EQUAL(&wanted, &actual_cpus)) {
+            return false;
+        }
+    }
+    return policy.fifo_priority == 0
+           || (actual_scheduler == SCHED_FIFO && actual_priority == policy.fifo_priority);
+}
+
+// ids of the threads of this process
+inline std::set<pid_t> list_threads() {
+    std::set<pid_t> tids;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return tids;
+    }
+    while (const dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            tids.insert(static_cast<pid_t>(std::atoi(entry->d_name)));
+        }
+    }
+    closedir(dir);
+    return tids;
+}
+
+}  // namespace thread_policy_detail
+
+// Apply policy to the calling thread, read it back and report whether it took effect.
+// SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance, without them it fails with EPERM.
+inline bool apply_thread_policy(const std::string &name, const ThreadPolicy &policy) {
+    if (policy.empty()) {
+        return true;
+    }
+    const pthread_t self = pthread_self();
+
+    if (!policy.cpus.empty()) {
+        const cpu_set_t set = thread_policy_detail::to_cpu_set(policy.cpus);
+        const int err = pthread_setaffinity_np(self, sizeof(set), &set);
+        if (err != 0) {
+            std::cout << "Cannot pin " << name << " " << policy.role << " thread: " << std::strerror(err)
+                      << std::endl;
+        }
+    }
+    if (policy.fifo_priority > 0) {
+        sched_param param;
+        param.sched_priority = policy.fifo_priority;
+        const int err = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (err != 0) {
+            std::cout << "Cannot make " << name << " " << policy.role << " thread SCHED_FIFO: "
+                      << std::strerror(err) << std::endl;
+        }
+    }
+
+    cpu_set_t actual_cpus;
+    CPU_ZERO(&actual_cpus);
+    pthread_getaffinity_np(self, sizeof(actual_cpus), &actual_cpus);
+    int actual_scheduler = SCHED_OTHER;
+    sched_param actual_param;
+    actual_param.sched_priority = 0;
+    pthread_getschedparam(self, &actual_scheduler, &actual_param);
+
+    const bool ok = thread_policy_detail::matches(policy, actual_cpus, actual_scheduler, actual_param.sched_priority);
+    std::cout << "LOG :: " << name << " " << policy.role << " THREAD " << (ok ? "RUNS ON " : "DOES NOT RUN ON ")
+              << policy.describe() << std::endl;
+    return ok;
+}
+
+// Threads spawned by a library, e.g. openvslam's mapping and loop closing threads, inherit the
+// affinity and scheduler of the thread that creates them. Apply the policy to the calling thread
+// with apply_thread_policy() before such a call, list the process's threads before and after it
+// with this and check the new ones. Other threads of the process may start meanwhile, so only
+// the expected number of matching threads is required.
+class SpawnedThreadCheck {
+private:
+    const std::set<pid_t> before;
+
+public:
+    SpawnedThreadCheck() : before(thread_policy_detail::list_threads()) {}
+
+    // Report how many threads started since construction run with policy
+    bool verify(const std::string &name, const ThreadPolicy &policy, const unsigned int expected) const {
+        if (policy.empty()) {
+            return true;
+        }
+        unsigned int spawned = 0;
+        unsigned int matching = 0;
+        for (const pid_t tid : thread_policy_detail::list_threads()) {
+            if (before.count(tid)) {
+                continue;
+            }
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            if (sched_getaffinity(tid, sizeof(cpus), &cpus) != 0) {
+                // it has exited meanwhile
+                continue;
+            }
+            sched_param param;
+            param.sched_priority = 0;
+            sched_getparam(tid, &param);
+            ++spawned;
+            matching += thread_policy_detail::matches(policy, cpus, sched_getscheduler(tid), param.sched_priority);
+        }
+        std::cout << "LOG :: " << name << " " << matching << " of " << spawned << " NEW THREADS RUN ON "
+                  << policy.describe() << " (" << expected << " " << policy.role << " threads expected)"
+                  << std::endl;
+        return matching >= expected;
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef OPEN_GL_TEST_TIMESTAMP_STATS_H
+#define OPEN_GL_TEST_TIMESTAMP_STATS_H
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// Running statistics over the intervals between consecutive frame timestamps
+class TimestampStats {
+private:
+    // expected interval, e.g. 1 / Camera.fps
+    const double nominal_interval;
+
+    bool has_last = false;
+    double last_timestamp = 0.0;
+
+    unsigned long num_intervals = 0;
+    double mean_interval = 0.0;
+    // sum of squared deviations from the mean (Welford)
+    double m2 = 0.0;
+    double max_interval = 0.0;
+
+    unsigned long num_gaps = 0;
+    unsigned long num_missing = 0;
+    unsigned long num_non_monotonic = 0;
+
+public:
+    explicit TimestampStats(const double nominal_interval) : nominal_interval(nominal_interval) {}
+
+    void add(const double timestamp) {
+        if (!has_last) {
+            has_last = true;
+            last_timestamp = timestamp;
+            return;
+        }
+
+        const double interval = timestamp - last_timestamp;
+        last_timestamp = timestamp;
+        if (interval <= 0.0) {
+            ++num_non_monotonic;
+            return;
+        }
+
+        ++num_intervals;
+        const double delta = interval - mean_interval;
+        mean_interval += delta / num_intervals;
+        m2 += delta * (interval - mean_interval);
+        if (interval > max_interval) {
+            max_interval = interval;
+        }
+
+        // anything longer than one and a half periods means at least one frame went missing
+        if (nominal_interval > 0.0 && interval > 1.5 * nominal_interval) {
+            ++num_gaps;
+            num_missing += static_cast<unsigned long>(std::lround(interval / nominal_interval)) - 1;
+        }
+    }
+
+    unsigned long intervals() const {
+        return num_intervals;
+    }
+
+    double mean() const {
+        return mean_interval;
+    }
+
+    // standard deviation of the frame interval
+    double jitter() const {
+        return num_intervals > 1 ? std::sqrt(m2 / (num_intervals - 1)) : 0.0;
+    }
+
+    double max() const {
+        return max_interval;
+    }
+
+    unsigned long gaps() const {
+        return num_gaps;
+    }
+
+    unsigned long missing() const {
+        return num_missing;
+    }
+
+    unsigned long non_monotonic() const {
+        return num_non_monotonic;
+    }
+
+    void print(const std::string &name) const {
+        std::cout << name << " frame interval: mean " << mean() << "[s], jitter " << jitter()
+                  << "[s], max " << max() << "[s], gaps " << gaps() << " (" << missing()
+                  << " frames missing), non-monotonic " << non_monotonic() << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,551 @@
+#ifndef OPEN_GL_TEST_TRACKING_PIPELINE_H
+#define OPEN_GL_TEST_TRACKING_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <openvslam/config.h>
+#include <openvslam/publish/frame_publisher.h>
+#include <openvslam/system.h>
+#include <openvslam/tracking_module.h>
+
+#include "capture_thread.h"
+#include "frame_governor.h"
+#include "gst_frame_source.h"
+#include "loop_ba_monitor.h"
+#include "mapping_switch.h"
+#include "mapping_throttle.h"
+#include "pose_channel.h"
+#include "preprocess.h"
+#include "replay_frame_source.h"
+#include "thread_policy.h"
+#include "timestamp_stats.h"
+
+// File or directory of the camera tagged camera, so cameras sharing a config don't overwrite each
+// other's: "map.msg" becomes "map.cam1.msg" and "session" "session.cam1". An empty tag or path is kept.
+inline std::string camera_file_path(const std::string &path, const std::string &camera) {
+    if (path.empty() || camera.empty()) {
+        return path;
+    }
+    const auto dot = path.find_last_of('.');
+    if (dot == std::string::npos || dot < path.find_last_of('/') + 1) {
+        return path + "." + camera;
+    }
+    return path.substr(0, dot) + "." + camera + path.substr(dot);
+}
+
+// Build the frame source selected by Capture.source in the config, capturing from device
+// when it is a camera. Recordings of a camera other than the first are tagged with camera.
+// Capture.record_path is ignored without record, for sources that only sample a few frames.
+inline std::unique_ptr<FrameSource> make_frame_source(const YAML::Node &yaml_node, const unsigned int cam_num,
+                                                      const std::string &camera = "", const bool record = true) {
+    std::unique_ptr<FrameSource> video;
+
+    const auto source = yaml_node["Capture.source"].as<std::string>("camera");
+    if (source == "gstreamer") {
+#ifdef USE_GSTREAMER
+        video.reset(new GstFrameSource(yaml_node["Capture.pipeline"].as<std::string>()));
+#else
+        std::cout << "Built without USE_GSTREAMER, falling back to camera " << cam_num << std::endl;
+#endif
+    } else if (source == "replay") {
+        video.reset(new ReplayFrameSource(yaml_node["Capture.replay_path"].as<std::string>(),
+                                          yaml_node["Capture.replay_realtime"].as<bool>(true)));
+    }
+    if (!video) {
+        video.reset(new VideoCaptureSource(cam_num));
+    }
+
+    const auto record_path = camera_file_path(yaml_node["Capture.record_path"].as<std::string>(""), camera);
+    if (record && !record_path.empty()) {
+        video.reset(new RecordingFrameSource(std::move(video), record_path,
+                                             yaml_node["Capture.record_queue"].as<unsigned int>(32)));
+    }
+    return video;
+}
+
+// what openvslam's tracker state means to consumers of the pose channel
+inline TrackingState tracking_state(const openvslam::tracker_state_t state) {
+    switch (state) {
+        case openvslam::tracker_state_t::Tracking:
+            return TrackingState::tracking;
+        case openvslam::tracker_state_t::Lost:
+            return TrackingState::lost;
+        default:
+            return TrackingState::initializing;
+    }
+}
+
+// seconds elapsed since start
+inline double seconds_since(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One camera's capture -> preprocess -> SLAM chain, with its own threads and metrics.
+// Several pipelines can run side by side in one process, one per camera.
+//
+// Startup is split in phases that run concurrently: building and starting the SLAM system
+// (dominated by the vocabulary load) and opening the frame source each get a thread, while
+// the caller sets up the window. Frames are passed through untracked until SLAM is ready.
+class TrackingPipeline {
+public:
+    // receives each processed frame, with its pose when it was tracked, and the image to display,
+    // which is empty when a YUV frame is to be displayed from its planes
+    typedef std::function<void(const Frame &, const cv::Mat &)> TrackedCallback;
+
+private:
+    const std::string name;
+    const std::shared_ptr<openvslam::config> cfg;
+    const std::string vocab_file_path;
+    const unsigned int cam_num;
+    // tags the files of every camera but the first, see camera_file_path()
+    const std::string file_tag;
+    const cv::Mat mask;
+    // map database written at shutdown, or localized against with Localization.enabled
+    const std::string map_db_path;
+    const double frame_interval;
+
+    std::unique_ptr<openvslam::system> SLAM;
+    std::atomic<bool> slam_ready{false};
+    // an existing map was loaded and the mapping module is off
+    bool localizing = false;
+    // loop bundle adjustment start and end events
+    std::unique_ptr<LoopBAMonitor> loop_BA;
+    // applies mapping_throttle's decisions, so tracking never waits on the mapper
+    std::unique_ptr<MappingSwitch> mapping_switch;
+
+    // startup phases
+    std::thread slam_thread;
+    std::thread source_thread;
+    bool source_opened = false;
+
+    std::unique_ptr<FrameSource> video;
+    std::unique_ptr<FrameRing> ring;
+    std::unique_ptr<CaptureThread> capture;
+
+    // downscale and grayscale conversion, into buffers reused across frames
+    Preprocessor preprocess;
+    // YUV frames go to on_tracked as they are, the renderer converts them
+    bool display_yuv = false;
+    // skips frames while tracking falls behind, set up once the source is known to be live
+    std::unique_ptr<FrameGovernor> governor;
+    // pauses mapping under load
+    MappingThrottle mapping_throttle;
+
+    // newest tracking result, for consumers on other threads
+    PoseChannel poses;
+
+    std::thread thread;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<bool> running{false};
+
+    // metrics
+    std::vector<double> track_times;
+    // intervals between the frames that actually reach the tracker
+    TimestampStats tracked_stats;
+    unsigned int num_frame = 0;
+    double elapsed = 0.0;
+
+    // optional per-frame trajectory, to compare replays of the same session across builds
+    std::ofstream trajectory;
+
+public:
+    TrackingPipeline(const std::string &name, const std::shared_ptr<openvslam::config> &cfg,
+                     const std::string &vocab_file_path, const unsigned int cam_num, const cv::Mat &mask,
+                     const float scale, const std::string &map_db_path, const bool primary)
+            : name(name), cfg(cfg), vocab_file_path(vocab_file_path), cam_num(cam_num), file_tag(primary ? "" : name), mask(mask),
+              map_db_path(camera_file_path(map_db_path, file_tag)), frame_interval(1.0 / cfg->camera_->fps_),
+              preprocess(scale, cfg->yaml_node_["Preprocess.fused_resize"].as<bool>(false)),
+              mapping_throttle(name, cfg->yaml_node_, frame_interval), tracked_stats(frame_interval) {}
+
+    ~TrackingPipeline() {
+        request_stop();
+        join();
+        wait_for_slam();
+        wait_for_source();
+    }
+
+    // Start building the SLAM system and opening the frame source, each on its own thread
+    void startup_async() {
+        slam_thread = std::thread([this] {
+            const auto tp_build = std::chrono::steady_clock::now();
+            SLAM.reset(new openvslam::system(cfg, vocab_file_path));
+            std::cout << "LOG :: " << name << " SLAM BUILT in " << seconds_since(tp_build) << "[s]" << std::endl;
+
+            // started before the mapping policy is applied, the helper threads keep the default CPU set and scheduler
+            loop_BA.reset(new LoopBAMonitor(*SLAM));
+            loop_BA->set_callbacks([this] { std::cout << "LOG :: " << name << " LOOP BA STARTED" << std::endl; },
+                                   [this](const double duration) {
+                                       std::cout << "LOG :: " << name << " LOOP BA FINISHED in " << duration
+                                                 << "[s]" << std::endl;
+                                   });
+            loop_BA->start();
+            if (mapping_throttle.is_enabled()) {
+                mapping_switch.reset(new MappingSwitch(*SLAM));
+                mapping_switch->start();
+            }
+
+            // openvslam's mapping and loop closing threads inherit this thread's CPU set and scheduler
+            const auto mapping_policy = thread_policy_from_yaml(cfg->yaml_node_, "mapping");
+            apply_thread_policy(name, mapping_policy);
+            const SpawnedThreadCheck spawned_check;
+
+            const auto tp_startup = std::chrono::steady_clock::now();
+            if (cfg->yaml_node_["Localization.enabled"].as<bool>(false)) {
+                localizing = start_localization();
+            } else {
+                SLAM->startup();
+            }
+            spawned_check.verify(name, mapping_policy, 2);
+            std::cout << "LOG :: " << name << " SLAM INITIALIZED in " << seconds_since(tp_startup) << "[s]"
+                      << std::endl;
+
+            slam_ready = true;
+        });
+
+        source_thread = std::thread([this] {
+            const auto tp_open = std::chrono::steady_clock::now();
+            source_opened = open_source();
+            std::cout << "LOG :: " << name << (source_opened ? " VIDEO OPENED" : " VIDEO NOT OPENED") << " in "
+                      << seconds_since(tp_open) << "[s]" << std::endl;
+        });
+    }
+
+    // Block until the frame source is opened. Returns false if it can't be.
+    bool wait_for_source() {
+        if (source_thread.joinable()) {
+            source_thread.join();
+        }
+        return source_opened;
+    }
+
+    void wait_for_slam() {
+        if (slam_thread.joinable()) {
+            slam_thread.join();
+        }
+    }
+
+private:
+    // Load the map database and start SLAM without mapping, falling back to mapping from scratch
+    // if there is no map. Returns true when localizing.
+    bool start_localization() {
+        if (map_db_path.empty() || !std::ifstream(map_db_path).good()) {
+            std::cout << "LOG :: " << name << " NO MAP AT \"" << map_db_path << "\", mapping from scratch" << std::endl;
+            SLAM->startup();
+            return false;
+        }
+
+        const auto tp_load = std::chrono::steady_clock::now();
+        SLAM->load_map_database(map_db_path);
+        std::cout << "LOG :: " << name << " MAP LOADED in " << seconds_since(tp_load) << "[s]" << std::endl;
+
+        // the loaded map is the reference, no initialization, keyframe insertion or local BA
+        SLAM->startup(false);
+        SLAM->disable_mapping_module();
+        std::cout << "LOG :: " << name << " LOCALIZING against " << map_db_path << std::endl;
+        return true;
+    }
+
+    bool open_source() {
+        const auto &yaml_node = cfg->yaml_node_;
+        video = make_frame_source(yaml_node, cam_num, file_tag);
+        std::cout << name << " video width: " << video->width() << std::endl;
+        std::cout << name << " video height: " << video->height() << std::endl;
+        if (!video->is_opened()) {
+            return false;
+        }
+
+        // capture runs on its own thread and never waits for tracking or drawing
+        auto policy = overflow_policy_from_string(yaml_node["Capture.overflow_policy"].as<std::string>("latest"));
+        if (!video->is_live() && policy != OverflowPolicy::block) {
+            std::cout << "Source is not live, capture will block instead of dropping frames" << std::endl;
+            policy = OverflowPolicy::block;
+        }
+        ring.reset(new FrameRing(yaml_node["Capture.ring_size"].as<unsigned int>(4), policy,
+                                 video->height(), video->width(), video->type()));
+        capture.reset(new CaptureThread(*video, *ring, frame_interval, name,
+                                        thread_policy_from_yaml(yaml_node, "capture")));
+
+        // frames of a paced-out replay must all be tracked, nothing piles up behind them anyway.
+        // Neither does it in the latest mailbox, which already hands over only the newest frame:
+        // skipping that one would just leave the tracker idle until the next capture.
+        const double budget = yaml_node["Governor.budget"].as<double>(0.0);
+        const bool governed = video->is_live() && policy != OverflowPolicy::latest
+                              && yaml_node["Governor.enabled"].as<bool>(true);
+        governor.reset(new FrameGovernor(name, governed,
+                                         budget > 0.0 ? budget : frame_interval,
+                                         yaml_node["Governor.max_stride"].as<unsigned int>(4)));
+
+        const auto trajectory_path = camera_file_path(yaml_node["Capture.trajectory_path"].as<std::string>(""),
+                                                      file_tag);
+        if (!trajectory_path.empty()) {
+            trajectory.open(trajectory_path);
+            trajectory.precision(17);
+        }
+        return true;
+    }
+
+public:
+    bool is_opened() const {
+        return video && video->is_opened();
+    }
+
+    int width() const {
+        return video->width();
+    }
+
+    int height() const {
+        return video->height();
+    }
+
+    const std::string &get_name() const {
+        return name;
+    }
+
+    PixelFormat source_format() const {
+        return video->format();
+    }
+
+    // live sources stamp frames with the monotonic clock, so their poses can be extrapolated to now
+    bool source_is_live() const {
+        return video->is_live();
+    }
+
+    // Skip the BGR conversion of YUV frames and hand their planes to on_tracked instead.
+    // Call before run().
+    void set_display_yuv(const bool yuv) {
+        display_yuv = yuv;
+    }
+
+    // Track frames until the source ends, SLAM asks to terminate, should_stop() returns true
+    // or request_stop() is called. Needs a successful wait_for_source().
+    // on_tracked, when set, receives every frame. While SLAM is still starting up frames
+    // of a live source are passed through to it untracked, other sources wait for SLAM.
+    void run(const std::function<bool()> &should_stop, const TrackedCallback &on_tracked) {
+        running = true;
+        // nothing displays the colour image without on_tracked
+        preprocess.set_convert_yuv(on_tracked && !display_yuv);
+        // started first so the capture thread doesn't inherit the tracking policy, it applies its own
+        capture->start();
+        // OpenCV starts its worker pool on the first parallel_for_ and the workers inherit the caller's
+        // CPU set and scheduler. Preprocessing would make this thread that caller, start it before.
+        cv::parallel_for_(cv::Range(0, std::max(1, cv::getNumThreads())), [](const cv::Range &) {});
+        // openvslam's tracking runs inside feed_monocular_frame(), on this thread
+        apply_thread_policy(name, thread_policy_from_yaml(cfg->yaml_node_, "tracking"));
+
+        // an unpaced replay has to reach the tracker frame for frame to be reproducible, so nothing
+        // is popped before SLAM is up; capture blocks on the full ring meanwhile
+        if (!video->is_live()) {
+            while (!slam_ready && !stop_requested && !(should_stop && should_stop())) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        Frame frame;
+        // throughput is measured from the first tracked frame on
+        auto tp_start = std::chrono::steady_clock::now();
+
+        bool is_not_end = true;
+        while (is_not_end) {
+            // check if the termination of SLAM system is requested or not
+            if (slam_ready && SLAM->terminate_is_requested()) {
+                break;
+            }
+
+            is_not_end = ring->pop(frame);
+            is_not_end = is_not_end && !stop_requested && !(should_stop && should_stop());
+
+            if (!is_not_end || frame.image.empty()) {
+                continue;
+            }
+            frame.has_pose = false;
+            if (slam_ready && !governor->should_track()) {
+                // not tracked, but still shown so the display doesn't stutter
+                if (on_tracked) {
+                    preprocess.process(frame);
+                    on_tracked(frame, preprocess.color());
+                }
+                continue;
+            }
+            preprocess.process(frame);
+
+            if (!slam_ready) {
+                poses.publish(PoseSample{frame.pose, frame.timestamp, frame.id, TrackingState::starting});
+                // live passthrough while the vocabulary is still loading
+                if (on_tracked) {
+                    on_tracked(frame, preprocess.color());
+                }
+                continue;
+            }
+
+            const auto tp_1 = std::chrono::steady_clock::now();
+            if (num_frame == 0) {
+                tp_start = tp_1;
+            }
+
+            // input the current frame and estimate the camera pose. The pose returned while
+            // initializing or lost is not one, only a frame that is tracked gets a pose.
+            const auto pose = SLAM->feed_monocular_frame(preprocess.gray(), frame.timestamp, mask);
+            const auto state = tracking_state(SLAM->get_frame_publisher()->get_tracking_state());
+            // taken before the display copy, so backpressure from the renderer doesn't count as tracking load
+            const auto tp_2 = std::chrono::steady_clock::now();
+            frame.has_pose = state == TrackingState::tracking;
+            if (frame.has_pose) {
+                frame.pose = pose;
+            }
+            poses.publish(PoseSample{pose, frame.timestamp, frame.id, state});
+
+            if (on_tracked) {
+                on_tracked(frame, preprocess.color());
+            }
+
+            const auto track_time = std::chrono::duration_cast<std::chrono::duration<double>>(tp_2 - tp_1).count();
+            track_times.push_back(track_time);
+            governor->report(track_time);
+            if (!localizing) {
+                switch (mapping_throttle.update(track_time, monotonic_now())) {
+                    case MappingThrottle::Decision::pause:
+                        mapping_switch->request(true);
+                        break;
+                    case MappingThrottle::Decision::resume:
+                        mapping_switch->request(false);
+                        break;
+                    case MappingThrottle::Decision::keep:
+                        break;
+                }
+            }
+
+            tracked_stats.add(frame.timestamp);
+            ++num_frame;
+
+            if (trajectory.is_open() && frame.has_pose) {
+                trajectory << frame.id << " " << frame.timestamp;
+                for (int i = 0; i < 12; ++i) {
+                    trajectory << " " << pose(i / 4, i % 4);
+                }
+                trajectory << "\n";
+            }
+        }
+        elapsed = seconds_since(tp_start);
+
+        PoseSample last;
+        if (!poses.read(last)) {
+            last = PoseSample{frame.pose, frame.timestamp, frame.id, TrackingState::stopped};
+        }
+        last.state = TrackingState::stopped;
+        poses.publish(last);
+
+        capture->stop();
+        running = false;
+    }
+
+    // run() on a thread of its own until request_stop()
+    void run_async(const TrackedCallback &on_tracked = nullptr) {
+        running = true;
+        thread = std::thread([this, on_tracked] { run(nullptr, on_tracked); });
+    }
+
+    // false once run() has returned, e.g. because the source ended
+    bool is_running() const {
+        return running;
+    }
+
+    // the newest pose, readable from any thread without blocking the tracker
+    const PoseChannel &pose_channel() const {
+        return poses;
+    }
+
+    // whether a loop bundle adjustment is running, cheap enough to ask every frame
+    bool loop_BA_is_running() const {
+        return slam_ready && loop_BA->is_running();
+    }
+
+    void request_stop() {
+        stop_requested = true;
+        if (ring) {
+            ring->close();
+        }
+    }
+
+    void join() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    // Stop the SLAM threads once loop BA is done and save the map if asked to and a path is given.
+    // A map that was only localized against is left as it is.
+    // A BA still running after timeout seconds (0 waits forever) is aborted.
+    void shutdown(const bool save_map, const double loop_BA_timeout = 0.0) {
+        // a window closed during startup still has to wait for the SLAM system to come up
+        wait_for_slam();
+        wait_for_source();
+
+        // wait until the loop BA is finished, shutdown starts as soon as it is
+        const bool finished = loop_BA->wait_until_idle(loop_BA_timeout, [this](const double elapsed_BA) {
+            std::cout << "LOG :: " << name << " WAITING FOR LOOP BA, running for " << elapsed_BA << "[s]"
+                      << std::endl;
+        });
+        if (!finished) {
+            std::cout << "LOG :: " << name << " LOOP BA TIMED OUT, aborting it" << std::endl;
+            SLAM->abort_loop_BA();
+            loop_BA->wait_until_idle(0.0);
+        }
+        loop_BA->stop();
+        if (mapping_switch) {
+            mapping_switch->stop();
+        }
+
+        // shutdown the SLAM process
+        SLAM->shutdown();
+
+        if (save_map && !localizing && !map_db_path.empty()) {
+            // output the map database
+            SLAM->save_map_database(map_db_path);
+        }
+    }
+
+    // Finish what the run leaves on disk: close the trajectory and release the source, which writes
+    // out a recording's queued frames and its index. Capture metrics are gone afterwards.
+    void close() {
+        trajectory.close();
+        capture.reset();
+        video.reset();
+    }
+
+    void print_stats() {
+        std::cout << "== " << name << " ==" << std::endl;
+        if (capture) {
+            std::cout << "captured frames: " << capture->captured() << std::endl;
+            ring->print("capture -> track");
+            capture->stats().print("captured");
+        }
+        tracked_stats.print("tracked");
+        if (governor) {
+            governor->print();
+        }
+        mapping_throttle.print();
+        std::cout << "tracked " << num_frame << " frames in " << elapsed << "[s] ("
+                  << (elapsed > 0.0 ? num_frame / elapsed : 0.0) << " fps)" << std::endl;
+
+        if (track_times.empty()) {
+            return;
+        }
+        std::sort(track_times.begin(), track_times.end());
+        const auto total_track_time = std::accumulate(track_times.begin(), track_times.end(), 0.0);
+        std::cout << "median tracking time: " << track_times.at(track_times.size() / 2) << "[s]" << std::endl;
+        std::cout << "mean tracking time: " << total_track_time / track_times.size() << "[s]" << std::endl;
+    }
+};
+
+#endif
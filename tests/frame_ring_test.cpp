@@ -0,0 +1,121 @@
+// Shutdown behaviour of FrameRing: a stage blocked on a full ring must come back once the
+// ring is closed, and frames queued before close() must still reach the consumer.
+// Exits non-zero on the first failed check.
+
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <thread>
+
+#include "frame_ring.h"
+
+static const int rows = 4;
+static const int cols = 4;
+
+static void check(const bool ok, const char *what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << std::endl;
+        std::exit(1);
+    }
+}
+
+// Wait for a stage thread to finish. A thread that never does can't be joined, so a hang
+// ends the whole test instead.
+static void join_or_fail(std::thread &thread, std::future<void> &done, const char *what) {
+    if (done.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        std::cout << "FAIL: " << what << std::endl;
+        std::_Exit(1);
+    }
+    thread.join();
+}
+
+// The tracker pushes into a block policy display ring that the renderer has stopped popping.
+// Stopping the pipeline the way main does, capture ring first and display ring second,
+// has to let the tracker out of push() and its loop.
+static void stop_pipeline_while_consumer_ring_is_full() {
+    FrameRing capture(4, OverflowPolicy::drop_oldest, rows, cols, CV_8UC1);
+    FrameRing display(2, OverflowPolicy::block, rows, cols, CV_8UC1);
+
+    std::promise<void> finished;
+    std::future<void> done = finished.get_future();
+    unsigned long tracked = 0;
+    std::thread tracker([&] {
+        Frame frame;
+        frame.image.create(rows, cols, CV_8UC1);
+        Frame out;
+        out.image.create(rows, cols, CV_8UC1);
+        while (capture.pop(frame)) {
+            out.id = frame.id;
+            display.push(out);
+            ++tracked;
+        }
+        finished.set_value();
+    });
+
+    Frame frame;
+    frame.image.create(rows, cols, CV_8UC1);
+    for (unsigned long id = 0; id < 4; ++id) {
+        frame.id = id;
+        check(capture.push(frame), "push into the capture ring");
+    }
+    // two frames fill the display ring, the third one blocks the tracker
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((display.size() < display.capacity() || capture.size() > 1)
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(display.size() == display.capacity(), "tracker fills the display ring");
+    check(done.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout,
+          "tracker waits on the full display ring");
+
+    capture.close();
+    display.close();
+    join_or_fail(tracker, done, "tracker still blocked after both rings were closed");
+
+    // whatever was still queued for the tracker is handed out before it sees the close
+    check(tracked == 4, "tracker drains the capture ring before it stops");
+    check(!display.push(frame), "push into a closed ring fails");
+}
+
+static void close_wakes_waiting_consumer() {
+    FrameRing ring(2, OverflowPolicy::block, rows, cols, CV_8UC1);
+
+    std::promise<void> finished;
+    std::future<void> done = finished.get_future();
+    bool popped = true;
+    std::thread consumer([&] {
+        Frame frame;
+        popped = ring.pop(frame);
+        finished.set_value();
+    });
+
+    check(done.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout,
+          "consumer waits on the empty ring");
+    ring.close();
+    join_or_fail(consumer, done, "consumer still blocked after the ring was closed");
+    check(!popped, "pop from a closed, empty ring fails");
+}
+
+static void close_keeps_queued_frames() {
+    FrameRing ring(3, OverflowPolicy::block, rows, cols, CV_8UC1);
+    Frame frame;
+    frame.image.create(rows, cols, CV_8UC1);
+    for (unsigned long id = 0; id < 2; ++id) {
+        frame.id = id;
+        ring.push(frame);
+    }
+    ring.close();
+
+    check(ring.pop(frame) && frame.id == 0, "first queued frame after close");
+    check(ring.pop(frame) && frame.id == 1, "second queued frame after close");
+    check(!ring.pop(frame), "pop from a closed, drained ring fails");
+}
+
+int main() {
+    stop_pipeline_while_consumer_ring_is_full();
+    close_wakes_waiting_consumer();
+    close_keeps_queued_frames();
+    std::cout << "frame ring: all checks passed" << std::endl;
+    return 0;
+}